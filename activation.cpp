@@ -0,0 +1,78 @@
+#include "activation.h"
+
+#include "kernels.h"
+#include "util.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace activation
+{
+	const char* name(Activation activation)
+	{
+		switch (activation)
+		{
+		case Activation::Identity: return "identity";
+		case Activation::Sigmoid: return "sigmoid";
+		case Activation::Relu: return "relu";
+		case Activation::LeakyRelu: return "leakyRelu";
+		case Activation::Custom: return "custom";
+		}
+		return "unknown";
+	}
+
+	template <typename T>
+	void forward(Activation activation, std::size_t n, const T* z, T* a)
+	{
+		switch (activation)
+		{
+		case Activation::Identity:
+			if (a != z)
+			{
+				std::copy(z, z + n, a);
+			}
+			return;
+		case Activation::Sigmoid:
+			kernels::sigmoid(n, z, a);
+			return;
+		case Activation::Relu:
+			kernels::rectifier(n, T{}, z, a);
+			return;
+		case Activation::LeakyRelu:
+			kernels::rectifier(n, T(util::LeakyReluSlope), z, a);
+			return;
+		case Activation::Custom:
+			break;
+		}
+		throw std::logic_error("No built-in kernel for this activation");
+	}
+
+	template <typename T>
+	void forward(Activation activation, std::size_t n, const T* z, T* a, T* derivative)
+	{
+		switch (activation)
+		{
+		case Activation::Identity:
+			std::copy(z, z + n, a);
+			std::fill(derivative, derivative + n, T(1));
+			return;
+		case Activation::Sigmoid:
+			kernels::sigmoidWithDerivative(n, z, a, derivative);
+			return;
+		case Activation::Relu:
+			kernels::rectifierWithDerivative(n, T{}, z, a, derivative);
+			return;
+		case Activation::LeakyRelu:
+			kernels::rectifierWithDerivative(n, T(util::LeakyReluSlope), z, a, derivative);
+			return;
+		case Activation::Custom:
+			break;
+		}
+		throw std::logic_error("No built-in kernel for this activation");
+	}
+
+	template void forward<float>(Activation, std::size_t, const float*, float*);
+	template void forward<double>(Activation, std::size_t, const double*, double*);
+	template void forward<float>(Activation, std::size_t, const float*, float*, float*);
+	template void forward<double>(Activation, std::size_t, const double*, double*, double*);
+}
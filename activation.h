@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// Built-in activation functions, evaluated on a whole layer at once by the
+// vectorized kernels. Custom marks a network using user supplied callbacks.
+// Model files store the values, new ones go before Custom.
+enum class Activation { Identity, Sigmoid, Relu, LeakyRelu, Custom };
+
+namespace activation
+{
+	const char* name(Activation activation);
+
+	// a[i] = f(z[i]), a may alias z
+	template <typename T>
+	void forward(Activation activation, std::size_t n, const T* z, T* a);
+
+	// a[i] = f(z[i]), derivative[i] = f'(z[i]) in a single pass, for training
+	template <typename T>
+	void forward(Activation activation, std::size_t n, const T* z, T* a, T* derivative);
+}
@@ -0,0 +1,106 @@
+#include "arena.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace util
+{
+
+template <typename T>
+Arena<T>::Arena(std::size_t size, bool hugePages)
+	: count(size)
+	, huge(hugePages && size * sizeof(T) >= HugePageSize)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	ptr = static_cast<T*>(::operator new(bytes(), std::align_val_t{alignment()}));
+#if defined(MADV_HUGEPAGE)
+	if (huge)
+	{
+		// only a hint, the block works the same without huge pages
+		madvise(ptr, bytes(), MADV_HUGEPAGE);
+	}
+#endif
+	std::memset(ptr, 0, bytes());
+}
+
+template <typename T>
+Arena<T>::Arena(const Arena& other)
+	: Arena(other.count, other.huge)
+{
+	used = other.used;
+	if (count)
+	{
+		std::memcpy(ptr, other.ptr, count * sizeof(T));
+	}
+}
+
+template <typename T>
+Arena<T>::Arena(Arena&& other) noexcept
+	: ptr(std::exchange(other.ptr, nullptr))
+	, count(std::exchange(other.count, 0))
+	, used(std::exchange(other.used, 0))
+	, huge(other.huge)
+{
+}
+
+template <typename T>
+Arena<T>& Arena<T>::operator=(Arena other) noexcept
+{
+	std::swap(ptr, other.ptr);
+	std::swap(count, other.count);
+	std::swap(used, other.used);
+	std::swap(huge, other.huge);
+	return *this;
+}
+
+template <typename T>
+Arena<T>::~Arena()
+{
+	if (ptr)
+	{
+		::operator delete(ptr, std::align_val_t{alignment()});
+	}
+}
+
+template <typename T>
+bool Arena<T>::hugePagesByDefault()
+{
+	static const bool enabled = std::getenv("NEURAL_HUGE_PAGES") && std::string(std::getenv("NEURAL_HUGE_PAGES")) == "1";
+	return enabled;
+}
+
+template <typename T>
+span<T> Arena<T>::take(std::size_t size)
+{
+	if (used + size > count)
+	{
+		throw std::length_error("Arena is full");
+	}
+	span<T> result { ptr + used, size };
+	used += padded<T>(size);
+	return result;
+}
+
+template <typename T>
+std::size_t Arena<T>::bytes() const
+{
+	const std::size_t size = count * sizeof(T);
+	return (size + alignment() - 1) / alignment() * alignment();
+}
+
+template class Arena<float>;
+template class Arena<double>;
+
+}
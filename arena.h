@@ -0,0 +1,68 @@
+#pragma once
+
+#include "util.h"
+
+#include <cstddef>
+
+namespace util
+{
+
+constexpr std::size_t HugePageSize = std::size_t(2) << 20;
+
+// Number of elements that fill whole cache lines, so arrays placed one after
+// another in an arena all start on a line boundary.
+template <typename T>
+constexpr std::size_t padded(std::size_t count)
+{
+	constexpr std::size_t line = CacheLineSize / sizeof(T);
+	return (count + line - 1) / line * line;
+}
+
+// One zeroed, cache-line aligned block that many arrays are carved from with
+// take(). Copying an arena is a single memcpy. With huge pages a block of at
+// least HugePageSize is aligned to it and madvise'd for transparent huge
+// pages; NEURAL_HUGE_PAGES=1 turns that on by default.
+template <typename T>
+class Arena
+{
+public:
+
+	Arena() = default;
+	explicit Arena(std::size_t size, bool hugePages = hugePagesByDefault());
+	Arena(const Arena& other);
+	Arena(Arena&& other) noexcept;
+	Arena& operator=(Arena other) noexcept;
+	~Arena();
+
+	static bool hugePagesByDefault();
+
+	T* data() { return ptr; }
+	const T* data() const { return ptr; }
+	std::size_t size() const { return count; }
+	bool hugePages() const { return huge; }
+
+	// The next `size` elements, the following array starts on a new cache line.
+	span<T> take(std::size_t size);
+
+	// The view at the same offset in this arena as `view` has in `other`.
+	template <typename U>
+	span<U> rebase(span<U> view, const Arena& other) const
+	{
+		return view.data() ? span<U> { ptr + (view.data() - other.ptr), view.size() } : view;
+	}
+
+private:
+
+	std::size_t alignment() const { return huge ? HugePageSize : CacheLineSize; }
+	std::size_t bytes() const;
+
+	T* ptr {};
+	std::size_t count {};
+	std::size_t used {};
+	bool huge {};
+};
+
+extern template class Arena<float>;
+extern template class Arena<double>;
+
+}
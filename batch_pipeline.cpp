@@ -0,0 +1,150 @@
+#include "batch_pipeline.h"
+
+#include <algorithm>
+
+
+template <typename T>
+BatchPipeline<T>::BatchPipeline(DatasetView view, std::size_t batchSize, PipelineOptions<T> options)
+	: view(std::move(view))
+	, batchSize(std::max<std::size_t>(batchSize, 1))
+	, options(std::move(options))
+	, perEpoch((this->view.size() + this->batchSize - 1) / this->batchSize)
+	, slots(std::max<std::size_t>(this->options.depth, 1))
+{
+	if (perEpoch == 0)
+	{
+		return;
+	}
+	for (std::size_t p {}; p < std::max<std::size_t>(this->options.producers, 1); p++)
+	{
+		producers.emplace_back(&BatchPipeline::produce, this);
+	}
+}
+
+template <typename T>
+BatchPipeline<T>::~BatchPipeline()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+}
+
+template <typename T>
+typename BatchPipeline<T>::Epoch BatchPipeline<T>::epoch()
+{
+	if (perEpoch == 0)
+	{
+		return { Iterator(this, 0), Iterator(this, 0) };
+	}
+
+	std::size_t unread {};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		unread = consumed;
+	}
+	while (unread < nextEpoch)
+	{
+		release(unread++);
+	}
+	const std::size_t first = nextEpoch;
+	nextEpoch += perEpoch;
+	return { Iterator(this, first), Iterator(this, nextEpoch) };
+}
+
+template <typename T>
+void BatchPipeline<T>::produce()
+{
+	for (;;)
+	{
+		std::size_t number {};
+		DatasetView samples;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			number = nextToProduce++;
+			// the slot is free once the batch `depth` places earlier was consumed
+			changed.wait(lock, [&] { return stopping || number < consumed + slots.size(); });
+			if (stopping)
+			{
+				return;
+			}
+			samples = order(number / perEpoch);
+		}
+
+		auto& slot = slots[number % slots.size()];
+		try
+		{
+			const std::size_t first = number % perEpoch * batchSize;
+			samples.assemble(first, std::min(batchSize, samples.size() - first), slot.batch.inputs, slot.batch.labels);
+			if (options.augmentation)
+			{
+				// seeded by the batch, so the augmentation doesn't depend on which producer ran it
+				std::mt19937 random(options.seed + unsigned(number));
+				for (auto& sample : slot.batch.inputs)
+				{
+					options.augmentation(sample, random);
+				}
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			error = std::current_exception();
+			stopping = true;
+			changed.notify_all();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.filled = number;
+		}
+		changed.notify_all();
+	}
+}
+
+template <typename T>
+const DatasetView& BatchPipeline<T>::order(std::size_t epoch)
+{
+	auto found = orders.find(epoch);
+	if (found == orders.end())
+	{
+		// no producer works on an epoch before the consumer's any more
+		orders.erase(orders.begin(), orders.lower_bound(consumed / perEpoch));
+		found = orders.emplace(epoch, options.shuffle ? view.shuffled(options.seed + unsigned(epoch)) : view).first;
+	}
+	return found->second;
+}
+
+template <typename T>
+const typename BatchPipeline<T>::Batch& BatchPipeline<T>::acquire(std::size_t number)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const auto& slot = slots[number % slots.size()];
+	changed.wait(lock, [&] { return slot.filled == number || error; });
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return slot.batch;
+}
+
+template <typename T>
+void BatchPipeline<T>::release(std::size_t number)
+{
+	// a batch is given back only once it was filled
+	acquire(number);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		consumed = number + 1;
+	}
+	changed.notify_all();
+}
+
+template class BatchPipeline<float>;
+template class BatchPipeline<double>;
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "dataset.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+template <typename T>
+struct PipelineOptions
+{
+	// Called by a producer on every sample of a batch once it is normalized.
+	using Augmentation = std::function<void(std::vector<T>& sample, std::mt19937& random)>;
+
+	// a new order every epoch, drawn from the seed, instead of the view's order
+	bool shuffle = false;
+	unsigned seed {};
+	// batches prepared ahead of the one in use, 2 for double buffering
+	std::size_t depth = 2;
+	std::size_t producers = 1;
+	Augmentation augmentation {};
+};
+
+
+// Prepares the batches of a DatasetView on background threads while the
+// current one trains. Producers sample the order of each epoch, gather and
+// normalize the pixels, augment them and gather the labels into a ring of
+// `depth` batches that is allocated once; they run up to `depth` batches
+// ahead of the consumer, across epochs, so the next epoch starts while the
+// last one is being evaluated. Batches come out in order:
+//
+//   BatchPipeline<double> pipeline(learning, 1000);
+//   for (const auto& batch : pipeline.epoch())
+//       trainer.learnEpoch(batch.inputs, batch.labels);
+//
+// A batch stays valid until the iterator moves past it. The producers have
+// threads of their own, so they never take pool workers from the trainer.
+template <typename T>
+class BatchPipeline
+{
+public:
+
+	struct Batch {
+		std::vector<std::vector<T>> inputs {};
+		// class indices as targets
+		std::vector<int> labels {};
+	};
+
+	class Iterator
+	{
+	public:
+		const Batch& operator*() const { return pipeline->acquire(number); }
+		const Batch* operator->() const { return &**this; }
+		Iterator& operator++() { pipeline->release(number++); return *this; }
+		bool operator==(const Iterator& other) const { return number == other.number; }
+		bool operator!=(const Iterator& other) const { return number != other.number; }
+
+	private:
+		friend class BatchPipeline;
+		Iterator(BatchPipeline* pipeline, std::size_t number) : pipeline(pipeline), number(number) {}
+
+		BatchPipeline* pipeline;
+		std::size_t number;
+	};
+
+	struct Epoch {
+		Iterator first;
+		Iterator last;
+
+		Iterator begin() const { return first; }
+		Iterator end() const { return last; }
+	};
+
+	// Batches of batchSize samples, the last one of an epoch holds the rest.
+	BatchPipeline(DatasetView view, std::size_t batchSize, PipelineOptions<T> options = {});
+	// Stops the producers; batches prepared ahead are dropped.
+	~BatchPipeline();
+
+	BatchPipeline(const BatchPipeline&) = delete;
+	BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+	std::size_t batchesPerEpoch() const { return perEpoch; }
+	// The batches of the next epoch. What an earlier epoch left unread is
+	// skipped. Rethrows an exception thrown by a producer.
+	Epoch epoch();
+
+private:
+
+	struct Slot {
+		Batch batch {};
+		// number of the batch held, valid once filled
+		std::size_t filled = std::size_t(-1);
+	};
+
+	void produce();
+	const DatasetView& order(std::size_t epoch);
+	const Batch& acquire(std::size_t number);
+	void release(std::size_t number);
+
+	const DatasetView view;
+	const std::size_t batchSize;
+	const PipelineOptions<T> options;
+	const std::size_t perEpoch;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<Slot> slots;
+	// the order of every epoch still being produced
+	std::map<std::size_t, DatasetView> orders {};
+	std::size_t nextToProduce {};
+	std::size_t consumed {};
+	// first batch of the epoch after the one handed out, only used by the consumer
+	std::size_t nextEpoch {};
+	bool stopping {};
+	std::exception_ptr error {};
+
+	std::vector<std::thread> producers {};
+};
+
+extern template class BatchPipeline<float>;
+extern template class BatchPipeline<double>;
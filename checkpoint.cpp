@@ -0,0 +1,348 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+	const char Magic[4] { 'C', 'K', 'P', 'T' };
+	const std::uint32_t Keyframe = 1;
+	// the shuffled bytes as they are, for records the run-length encoding would grow
+	const std::uint32_t Stored = 2;
+
+	struct RecordHeader
+	{
+		char magic[4];
+		std::uint32_t flags;
+		std::uint32_t scalarSize;
+		std::int32_t epoch;
+		std::uint64_t parameterCount;
+		std::uint64_t payloadSize;
+		std::uint64_t checksum;
+	};
+
+	std::uint64_t fnv1a(const unsigned char* data, std::size_t size)
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		for (std::size_t i {}; i < size; i++)
+		{
+			hash = (hash ^ data[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void putVarint(std::vector<unsigned char>& out, std::size_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<unsigned char>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<unsigned char>(value));
+	}
+
+	bool getVarint(const unsigned char*& in, const unsigned char* end, std::size_t& value)
+	{
+		value = 0;
+		for (int shift {}; in < end && shift < 64; shift += 7)
+		{
+			const unsigned char byte = *in++;
+			value |= std::size_t(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// byte b of value i goes to shuffled[b * count + i]
+	void xorShuffle(const unsigned char* values, const unsigned char* base, std::size_t count, std::size_t width, unsigned char* shuffled)
+	{
+		for (std::size_t i {}; i < count; i++)
+		{
+			for (std::size_t b {}; b < width; b++)
+			{
+				shuffled[b * count + i] = values[i * width + b] ^ base[i * width + b];
+			}
+		}
+	}
+
+	void unshuffleXor(const unsigned char* shuffled, std::size_t count, std::size_t width, unsigned char* values)
+	{
+		for (std::size_t i {}; i < count; i++)
+		{
+			for (std::size_t b {}; b < width; b++)
+			{
+				values[i * width + b] ^= shuffled[b * count + i];
+			}
+		}
+	}
+
+	// (zero run, literal run, literals)*
+	void encodeZeroRuns(const std::vector<unsigned char>& in, std::vector<unsigned char>& out)
+	{
+		out.clear();
+		for (std::size_t i {}; i < in.size(); )
+		{
+			const std::size_t zeros_begin = i;
+			while (i < in.size() && in[i] == 0)
+			{
+				i++;
+			}
+			const std::size_t literals_begin = i;
+			while (i < in.size() && in[i] != 0)
+			{
+				i++;
+			}
+			putVarint(out, literals_begin - zeros_begin);
+			putVarint(out, i - literals_begin);
+			out.insert(out.end(), in.begin() + literals_begin, in.begin() + i);
+		}
+	}
+
+	bool decodeZeroRuns(const unsigned char* in, const unsigned char* end, std::vector<unsigned char>& out)
+	{
+		std::size_t position {};
+		while (in < end)
+		{
+			std::size_t zeros, literals;
+			if (!getVarint(in, end, zeros) || !getVarint(in, end, literals)
+				|| zeros + literals > out.size() - position || std::size_t(end - in) < literals)
+			{
+				return false;
+			}
+			std::fill_n(out.begin() + position, zeros, 0);
+			position += zeros;
+			std::copy(in, in + literals, out.begin() + position);
+			position += literals;
+			in += literals;
+		}
+		return position == out.size();
+	}
+}
+
+
+template <typename T>
+Checkpointer<T>::Checkpointer(std::string path, int everyEpochs, double everySeconds)
+	: path(std::move(path))
+	, everyEpochs(everyEpochs)
+	, everySeconds(everySeconds)
+	, writer(&Checkpointer::work, this)
+{
+}
+
+template <typename T>
+Checkpointer<T>::~Checkpointer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_one();
+	writer.join();
+}
+
+template <typename T>
+bool Checkpointer<T>::update(const Network<T>& network, int epoch)
+{
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastTime).count();
+	if ((everyEpochs > 0 && epoch - lastEpoch >= everyEpochs) || (everySeconds > 0 && seconds >= everySeconds))
+	{
+		save(network, epoch);
+		return true;
+	}
+	return false;
+}
+
+template <typename T>
+void Checkpointer<T>::save(const Network<T>& network, int epoch)
+{
+	const auto parameters = network.parameters();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		rethrowError();
+		snapshot.assign(parameters.begin(), parameters.end());
+		snapshotEpoch = epoch;
+		pending = true;
+	}
+	changed.notify_one();
+
+	lastEpoch = epoch;
+	lastTime = std::chrono::steady_clock::now();
+}
+
+template <typename T>
+void Checkpointer<T>::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [&] { return !pending && !writing; });
+	rethrowError();
+}
+
+template <typename T>
+void Checkpointer<T>::rethrowError()
+{
+	if (error)
+	{
+		// reported once, the writer carries on with the next snapshot
+		auto rethrown = error;
+		error = nullptr;
+		std::rethrow_exception(rethrown);
+	}
+}
+
+template <typename T>
+void Checkpointer<T>::work()
+{
+	for (;;)
+	{
+		int epoch;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return pending || stopping; });
+			if (!pending)
+			{
+				return;
+			}
+			std::swap(snapshot, current);
+			epoch = snapshotEpoch;
+			pending = false;
+			writing = true;
+		}
+
+		try
+		{
+			writeRecord(epoch);
+		}
+		catch (...)
+		{
+			// the file may end in a partial record, start over with a keyframe
+			records = 0;
+			std::lock_guard<std::mutex> lock(mutex);
+			error = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			writing = false;
+		}
+		idle.notify_all();
+	}
+}
+
+template <typename T>
+void Checkpointer<T>::writeRecord(int epoch)
+{
+	const bool keyframe = records % KeyframeInterval == 0 || previous.size() != current.size();
+	if (keyframe)
+	{
+		previous.assign(current.size(), T{});
+	}
+
+	const std::size_t width = sizeof(T);
+	shuffled.resize(current.size() * width);
+	xorShuffle(reinterpret_cast<const unsigned char*>(current.data()), reinterpret_cast<const unsigned char*>(previous.data()),
+			   current.size(), width, shuffled.data());
+	encodeZeroRuns(shuffled, payload);
+	const bool stored = payload.size() >= shuffled.size();
+	const auto& data = stored ? shuffled : payload;
+
+	RecordHeader header {};
+	std::copy(std::begin(Magic), std::end(Magic), header.magic);
+	header.flags = (keyframe ? Keyframe : 0) | (stored ? Stored : 0);
+	header.scalarSize = sizeof(T);
+	header.epoch = epoch;
+	header.parameterCount = current.size();
+	header.payloadSize = data.size();
+	header.checksum = fnv1a(data.data(), data.size());
+
+	// a keyframe replaces the file only once it is complete
+	const std::string target = keyframe ? path + ".tmp" : path;
+	{
+		std::ofstream file(target, std::ios::binary | (keyframe ? std::ios::trunc : std::ios::app));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file.flush())
+		{
+			throw std::runtime_error("Cannot write " + target);
+		}
+	}
+	if (keyframe)
+	{
+#if defined(_WIN32)
+		std::remove(path.c_str());
+#endif
+		if (std::rename(target.c_str(), path.c_str()) != 0)
+		{
+			throw std::runtime_error("Cannot replace " + path);
+		}
+	}
+
+	std::swap(previous, current);
+	records++;
+}
+
+template <typename T>
+int Checkpointer<T>::resume(const std::string& path, Network<T>& network)
+{
+	std::ifstream file(path, std::ios::binary);
+	const std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	const auto parameters = network.parameters();
+	std::vector<T> values(parameters.size());
+	std::vector<unsigned char> shuffled(parameters.size() * sizeof(T));
+	int epoch {};
+
+	for (std::size_t offset {}; contents.size() - offset >= sizeof(RecordHeader); )
+	{
+		RecordHeader header;
+		std::memcpy(&header, contents.data() + offset, sizeof(header));
+		const unsigned char* payload = contents.data() + offset + sizeof(header);
+		if (!std::equal(std::begin(Magic), std::end(Magic), header.magic)
+			|| header.payloadSize > contents.size() - offset - sizeof(header)
+			|| fnv1a(payload, header.payloadSize) != header.checksum)
+		{
+			break;
+		}
+		if (header.scalarSize != sizeof(T) || header.parameterCount != parameters.size())
+		{
+			throw std::runtime_error(path + " is a checkpoint of a different network");
+		}
+		if (header.flags & Stored)
+		{
+			if (header.payloadSize != shuffled.size())
+			{
+				break;
+			}
+			std::copy(payload, payload + header.payloadSize, shuffled.begin());
+		}
+		else if (!decodeZeroRuns(payload, payload + header.payloadSize, shuffled))
+		{
+			break;
+		}
+		if (header.flags & Keyframe)
+		{
+			std::fill(values.begin(), values.end(), T{});
+		}
+
+		unshuffleXor(shuffled.data(), values.size(), sizeof(T), reinterpret_cast<unsigned char*>(values.data()));
+		epoch = header.epoch;
+		offset += sizeof(header) + header.payloadSize;
+	}
+
+	if (epoch > 0)
+	{
+		std::copy(values.begin(), values.end(), parameters.begin());
+	}
+	return epoch;
+}
+
+template class Checkpointer<float>;
+template class Checkpointer<double>;
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "network.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Saves a network's parameters every few epochs or seconds without stalling
+// training: update() only copies the parameter block, a background thread
+// compresses and writes it.
+//
+// The file is a sequence of records. A keyframe holds the full parameters and
+// starts a new file (written aside and renamed over the old one); each record
+// after it holds the XOR with the previous snapshot. The bytes of a record are
+// shuffled (the first bytes of all values, then the second bytes, ...) and
+// runs of zero bytes are run-length encoded, so the sign and exponent bytes of
+// slowly moving weights cost next to nothing.
+template <typename T>
+class Checkpointer
+{
+public:
+
+	// 0 disables either trigger.
+	explicit Checkpointer(std::string path, int everyEpochs = 1, double everySeconds = 0);
+	// Finishes writing what was handed over.
+	~Checkpointer();
+
+	Checkpointer(const Checkpointer&) = delete;
+	Checkpointer& operator=(const Checkpointer&) = delete;
+
+	// Snapshots the parameters if enough epochs or seconds passed since the last
+	// snapshot and returns whether it did. A snapshot still waiting to be
+	// written is replaced by the newer one. Both rethrow a write that failed
+	// since the last call.
+	bool update(const Network<T>& network, int epoch);
+	void save(const Network<T>& network, int epoch);
+	// Blocks until every snapshot is on disk and rethrows a failed write.
+	void wait();
+
+	// Loads the latest complete checkpoint into the network and returns its
+	// epoch, 0 if there is none. A damaged tail (a crash during a write) is
+	// skipped; a checkpoint of a differently shaped network throws.
+	static int resume(const std::string& path, Network<T>& network);
+
+private:
+
+	static const int KeyframeInterval = 32;
+
+	// with the mutex held
+	void rethrowError();
+	void work();
+	void writeRecord(int epoch);
+
+	const std::string path;
+	const int everyEpochs;
+	const double everySeconds;
+	int lastEpoch {};
+	std::chrono::steady_clock::time_point lastTime { std::chrono::steady_clock::now() };
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::condition_variable idle;
+	// filled by save(), taken over by the writer
+	std::vector<T> snapshot {};
+	int snapshotEpoch {};
+	bool pending {};
+	bool writing {};
+	bool stopping {};
+	std::exception_ptr error {};
+
+	// writer thread only
+	std::vector<T> current {};
+	std::vector<T> previous {};
+	std::vector<unsigned char> shuffled {};
+	std::vector<unsigned char> payload {};
+	int records {};
+
+	std::thread writer;
+};
+
+extern template class Checkpointer<float>;
+extern template class Checkpointer<double>;
@@ -0,0 +1,132 @@
+#include "dataset.h"
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+
+Dataset::Dataset(std::size_t sampleSize, std::vector<std::uint8_t> samples, std::vector<int> labels)
+{
+	auto owned = std::make_shared<const std::vector<std::uint8_t>>(std::move(samples));
+	const util::span<const std::uint8_t> bytes(*owned);
+	*this = Dataset(sampleSize, std::move(owned), bytes, std::move(labels));
+}
+
+Dataset::Dataset(std::size_t sampleSize, std::shared_ptr<const void> storage, util::span<const std::uint8_t> samples, std::vector<int> labels)
+	: storage(std::move(storage))
+	, samples(samples)
+	, labelValues(std::move(labels))
+	, bytesPerSample(sampleSize)
+{
+	if (samples.size() != sampleSize * labelValues.size())
+	{
+		throw std::invalid_argument("A dataset needs sampleSize bytes per label");
+	}
+}
+
+template <typename T>
+void Dataset::normalize(std::size_t i, std::vector<T>& values) const
+{
+	values.resize(bytesPerSample);
+	kernels::normalizeBytes(bytesPerSample, sample(i).data(), T(255), values.data());
+}
+
+template <typename T>
+void Dataset::assemble(std::size_t first, std::size_t count, std::vector<std::vector<T>>& batch) const
+{
+	batch.resize(count);
+	for (std::size_t i {}; i < count; i++)
+	{
+		normalize(first + i, batch[i]);
+	}
+}
+
+
+DatasetView::DatasetView(Dataset dataset)
+	: data(std::make_shared<const Dataset>(std::move(dataset)))
+	, samples(data->size())
+{
+}
+
+DatasetView::DatasetView(std::shared_ptr<const Dataset> data, std::shared_ptr<const std::vector<std::uint32_t>> indices, std::size_t first, std::size_t samples)
+	: data(std::move(data))
+	, indices(std::move(indices))
+	, first(first)
+	, samples(samples)
+{
+}
+
+DatasetView DatasetView::range(std::size_t offset, std::size_t count) const
+{
+	offset = std::min(offset, samples);
+	return { data, indices, first + offset, std::min(count, samples - offset) };
+}
+
+std::pair<DatasetView, DatasetView> DatasetView::split(std::size_t count) const
+{
+	count = std::min(count, samples);
+	return { range(0, count), range(count, samples - count) };
+}
+
+DatasetView DatasetView::subset(const std::vector<std::size_t>& positions) const
+{
+	auto selected = std::make_shared<std::vector<std::uint32_t>>(positions.size());
+	std::transform(positions.begin(), positions.end(), selected->begin(), [&](std::size_t i) { return std::uint32_t(index(i)); });
+	return { data, std::move(selected), 0, positions.size() };
+}
+
+DatasetView DatasetView::shuffled(unsigned seed) const
+{
+	std::vector<std::size_t> order(samples);
+	std::iota(order.begin(), order.end(), std::size_t {});
+	std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+	return subset(order);
+}
+
+std::pair<DatasetView, DatasetView> DatasetView::fold(std::size_t folds, std::size_t fold) const
+{
+	if (fold >= folds)
+	{
+		throw std::out_of_range("No such fold");
+	}
+	const std::size_t begin = samples * fold / folds;
+	const std::size_t end = samples * (fold + 1) / folds;
+
+	std::vector<std::size_t> training(samples - (end - begin));
+	std::iota(training.begin(), training.begin() + begin, std::size_t {});
+	std::iota(training.begin() + begin, training.end(), end);
+	return { subset(training), range(begin, end - begin) };
+}
+
+template <typename T>
+void DatasetView::assemble(std::size_t first, std::size_t count, std::vector<std::vector<T>>& batch) const
+{
+	batch.resize(count);
+	for (std::size_t i {}; i < count; i++)
+	{
+		data->normalize(index(first + i), batch[i]);
+	}
+}
+
+template <typename T>
+void DatasetView::assemble(std::size_t first, std::size_t count, std::vector<std::vector<T>>& batch, std::vector<int>& labels) const
+{
+	assemble(first, count, batch);
+	labels.resize(count);
+	for (std::size_t i {}; i < count; i++)
+	{
+		labels[i] = label(first + i);
+	}
+}
+
+template void Dataset::normalize<float>(std::size_t, std::vector<float>&) const;
+template void Dataset::normalize<double>(std::size_t, std::vector<double>&) const;
+template void Dataset::assemble<float>(std::size_t, std::size_t, std::vector<std::vector<float>>&) const;
+template void Dataset::assemble<double>(std::size_t, std::size_t, std::vector<std::vector<double>>&) const;
+template void DatasetView::assemble<float>(std::size_t, std::size_t, std::vector<std::vector<float>>&) const;
+template void DatasetView::assemble<double>(std::size_t, std::size_t, std::vector<std::vector<double>>&) const;
+template void DatasetView::assemble<float>(std::size_t, std::size_t, std::vector<std::vector<float>>&, std::vector<int>&) const;
+template void DatasetView::assemble<double>(std::size_t, std::size_t, std::vector<std::vector<double>>&, std::vector<int>&) const;
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+// Samples kept as raw bytes, sampleSize of them per sample, in one contiguous
+// block next to their labels: an MNIST image takes 784 bytes instead of a
+// vector of 784 doubles with an allocation of its own. The bytes become
+// values in [0, 1] only when a batch is assembled. Copies share the block,
+// which may be a file mapping (mnist::readTrainingSet).
+class Dataset
+{
+public:
+
+	Dataset() = default;
+	// Throws std::invalid_argument unless there are sampleSize bytes per label.
+	Dataset(std::size_t sampleSize, std::vector<std::uint8_t> samples, std::vector<int> labels);
+	// The samples point into storage, which is kept alive.
+	Dataset(std::size_t sampleSize, std::shared_ptr<const void> storage, util::span<const std::uint8_t> samples, std::vector<int> labels);
+
+	std::size_t size() const { return labelValues.size(); }
+	bool empty() const { return labelValues.empty(); }
+	std::size_t sampleSize() const { return bytesPerSample; }
+	// Bytes taken by the samples and their labels.
+	std::size_t bytes() const { return samples.size() + labelValues.size() * sizeof(int); }
+
+	util::span<const std::uint8_t> sample(std::size_t i) const { return samples.subspan(i * bytesPerSample, bytesPerSample); }
+	int label(std::size_t i) const { return labelValues[i]; }
+	util::span<const int> labels() const { return labelValues; }
+
+	// Normalizes sample i into values, resized to sampleSize values in [0, 1].
+	template <typename T>
+	void normalize(std::size_t i, std::vector<T>& values) const;
+	// Normalizes the samples first to first + count - 1 into batch, resized to
+	// count vectors of sampleSize values. Allocation free once batch held as
+	// many samples.
+	template <typename T>
+	void assemble(std::size_t first, std::size_t count, std::vector<std::vector<T>>& batch) const;
+
+private:
+
+	std::shared_ptr<const void> storage {};
+	util::span<const std::uint8_t> samples {};
+	std::vector<int> labelValues {};
+	std::size_t bytesPerSample {};
+};
+
+
+// Samples of a Dataset picked by index without copying them: ranges for
+// training and verification splits, index lists for subsets, shuffles and
+// k-fold partitions. Views share the dataset and their index list, so they
+// are cheap to copy, and views of views index the dataset directly.
+class DatasetView
+{
+public:
+
+	DatasetView() = default;
+	// Every sample of the dataset.
+	explicit DatasetView(Dataset dataset);
+
+	std::size_t size() const { return samples; }
+	bool empty() const { return samples == 0; }
+	const Dataset& dataset() const { return *data; }
+
+	// Position of sample i in the dataset.
+	std::size_t index(std::size_t i) const { return indices ? (*indices)[first + i] : first + i; }
+	util::span<const std::uint8_t> sample(std::size_t i) const { return data->sample(index(i)); }
+	int label(std::size_t i) const { return data->label(index(i)); }
+
+	// Samples offset to offset + count - 1.
+	DatasetView range(std::size_t offset, std::size_t count) const;
+	// The first count samples and the rest.
+	std::pair<DatasetView, DatasetView> split(std::size_t count) const;
+	// The samples at the given positions of this view, in that order.
+	DatasetView subset(const std::vector<std::size_t>& positions) const;
+	// Every sample, in an order given by the seed.
+	DatasetView shuffled(unsigned seed) const;
+	// Training and verification samples of k-fold cross-validation: the
+	// view is cut into `folds` consecutive parts, part `fold` verifies and
+	// the others train. Throws std::out_of_range unless fold < folds.
+	std::pair<DatasetView, DatasetView> fold(std::size_t folds, std::size_t fold) const;
+
+	// Dataset::assemble for samples first to first + count - 1 of the view,
+	// optionally gathering their labels as well.
+	template <typename T>
+	void assemble(std::size_t first, std::size_t count, std::vector<std::vector<T>>& batch) const;
+	template <typename T>
+	void assemble(std::size_t first, std::size_t count, std::vector<std::vector<T>>& batch, std::vector<int>& labels) const;
+
+private:
+
+	DatasetView(std::shared_ptr<const Dataset> data, std::shared_ptr<const std::vector<std::uint32_t>> indices, std::size_t first, std::size_t samples);
+
+	std::shared_ptr<const Dataset> data {};
+	// dataset positions of the samples, or null for consecutive ones
+	std::shared_ptr<const std::vector<std::uint32_t>> indices {};
+	std::size_t first {};
+	std::size_t samples {};
+};
+
+extern template void Dataset::normalize<float>(std::size_t, std::vector<float>&) const;
+extern template void Dataset::normalize<double>(std::size_t, std::vector<double>&) const;
+extern template void Dataset::assemble<float>(std::size_t, std::size_t, std::vector<std::vector<float>>&) const;
+extern template void Dataset::assemble<double>(std::size_t, std::size_t, std::vector<std::vector<double>>&) const;
+extern template void DatasetView::assemble<float>(std::size_t, std::size_t, std::vector<std::vector<float>>&) const;
+extern template void DatasetView::assemble<double>(std::size_t, std::size_t, std::vector<std::vector<double>>&) const;
+extern template void DatasetView::assemble<float>(std::size_t, std::size_t, std::vector<std::vector<float>>&, std::vector<int>&) const;
+extern template void DatasetView::assemble<double>(std::size_t, std::size_t, std::vector<std::vector<double>>&, std::vector<int>&) const;
@@ -0,0 +1,164 @@
+#include "evaluation.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+	// Spreads batches of batchSize samples over the pool. classifyBatch(begin,
+	// count, record) calls record(s, predicted class) for the samples of a batch,
+	// label(i) is the expected class of sample i.
+	template <typename Label, typename ClassifyBatch>
+	Evaluation evaluateBatches(std::size_t classes, std::size_t samples, Label label, std::size_t batchSize, ThreadPool& pool, ClassifyBatch classifyBatch)
+	{
+		for (std::size_t i {}; i < samples; i++)
+		{
+			if (label(i) < 0 || std::size_t(label(i)) >= classes)
+			{
+				throw std::invalid_argument("Label " + std::to_string(label(i)) + " of sample " + std::to_string(i) + " is not a class of the model");
+			}
+		}
+		batchSize = std::max<std::size_t>(batchSize, 1);
+		const std::size_t batches = (samples + batchSize - 1) / batchSize;
+
+		// one confusion matrix per batch, summed once all are done
+		std::vector<std::vector<std::size_t>> partial(batches, std::vector<std::size_t>(classes * classes));
+
+		parallel_for(0, batches, 1, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t batch = first; batch < last; batch++)
+			{
+				const std::size_t begin = batch * batchSize;
+				auto& confusion = partial[batch];
+				classifyBatch(begin, std::min(batchSize, samples - begin), [&](std::size_t s, std::size_t predicted)
+				{
+					confusion[label(begin + s) * classes + predicted]++;
+				});
+			}
+		}, pool);
+
+		Evaluation result { classes, 0, samples, std::vector<std::size_t>(classes * classes) };
+		for (const auto& confusion : partial)
+		{
+			std::transform(confusion.begin(), confusion.end(), result.confusion.begin(), result.confusion.begin(), std::plus<std::size_t>());
+		}
+		for (std::size_t c {}; c < classes; c++)
+		{
+			result.correct += result.count(c, c);
+		}
+
+		return result;
+	}
+
+	template <typename T>
+	void checkLabelCount(util::span<const std::vector<T>> inputs, util::span<const int> labels)
+	{
+		if (inputs.size() != labels.size())
+		{
+			throw std::invalid_argument("Evaluating " + std::to_string(inputs.size()) + " inputs against " + std::to_string(labels.size()) + " labels");
+		}
+	}
+}
+
+
+template <typename T>
+Evaluation evaluate(const Model<T>& model, util::nondeduced_t<util::span<const std::vector<T>>> inputs, util::span<const int> labels,
+					std::size_t batchSize, ThreadPool& pool)
+{
+	checkLabelCount(inputs, labels);
+	const std::size_t classes = model.outputSize();
+	return evaluateBatches(classes, labels.size(), [&](std::size_t i) { return labels[i]; }, batchSize, pool, [&](std::size_t begin, std::size_t count, auto record)
+	{
+		thread_local InferenceContext<T> context;
+		const auto outputs = model.predictBatch(inputs.subspan(begin, count), context);
+
+		for (std::size_t s {}; s < count; s++)
+		{
+			const auto row = outputs.subspan(s * classes, classes);
+			record(s, std::max_element(row.begin(), row.end()) - row.begin());
+		}
+	});
+}
+
+template <typename T>
+Evaluation evaluate(const Model<T>& model, const DatasetView& view, std::size_t batchSize, ThreadPool& pool)
+{
+	const std::size_t classes = model.outputSize();
+	return evaluateBatches(classes, view.size(), [&](std::size_t i) { return view.label(i); }, batchSize, pool,
+						   [&](std::size_t begin, std::size_t count, auto record)
+	{
+		thread_local InferenceContext<T> context;
+		thread_local std::vector<std::vector<T>> batch;
+		view.assemble(begin, count, batch);
+		const auto outputs = model.predictBatch(batch, context);
+
+		for (std::size_t s {}; s < count; s++)
+		{
+			const auto row = outputs.subspan(s * classes, classes);
+			record(s, std::max_element(row.begin(), row.end()) - row.begin());
+		}
+	});
+}
+
+template <typename T>
+Evaluation evaluate(const QuantizedModel& model, util::span<const std::vector<T>> inputs, util::span<const int> labels,
+					std::size_t batchSize, ThreadPool& pool)
+{
+	checkLabelCount(inputs, labels);
+	return evaluateBatches(model.outputSize(), labels.size(), [&](std::size_t i) { return labels[i]; }, batchSize, pool, [&](std::size_t begin, std::size_t count, auto record)
+	{
+		thread_local QuantizedContext context;
+
+		for (std::size_t s {}; s < count; s++)
+		{
+			record(s, model.classify(util::span<const T>(inputs[begin + s]), context));
+		}
+	});
+}
+
+template <typename T>
+Evaluation evaluate(const SparseModel<T>& model, util::nondeduced_t<util::span<const std::vector<T>>> inputs, util::span<const int> labels,
+					std::size_t batchSize, ThreadPool& pool)
+{
+	checkLabelCount(inputs, labels);
+	return evaluateBatches(model.outputSize(), labels.size(), [&](std::size_t i) { return labels[i]; }, batchSize, pool, [&](std::size_t begin, std::size_t count, auto record)
+	{
+		thread_local InferenceContext<T> context;
+
+		for (std::size_t s {}; s < count; s++)
+		{
+			record(s, model.classify(inputs[begin + s], context));
+		}
+	});
+}
+
+template <typename T>
+Evaluation evaluate(const SparseModel<T>& model, const DatasetView& view, std::size_t batchSize, ThreadPool& pool)
+{
+	return evaluateBatches(model.outputSize(), view.size(), [&](std::size_t i) { return view.label(i); }, batchSize, pool,
+						   [&](std::size_t begin, std::size_t count, auto record)
+	{
+		thread_local InferenceContext<T> context;
+		thread_local std::vector<std::vector<T>> batch;
+		view.assemble(begin, count, batch);
+
+		for (std::size_t s {}; s < count; s++)
+		{
+			record(s, model.classify(batch[s], context));
+		}
+	});
+}
+
+template Evaluation evaluate<float>(const Model<float>&, util::span<const std::vector<float>>, util::span<const int>, std::size_t, ThreadPool&);
+template Evaluation evaluate<double>(const Model<double>&, util::span<const std::vector<double>>, util::span<const int>, std::size_t, ThreadPool&);
+template Evaluation evaluate<float>(const Model<float>&, const DatasetView&, std::size_t, ThreadPool&);
+template Evaluation evaluate<double>(const Model<double>&, const DatasetView&, std::size_t, ThreadPool&);
+template Evaluation evaluate<float>(const QuantizedModel&, util::span<const std::vector<float>>, util::span<const int>, std::size_t, ThreadPool&);
+template Evaluation evaluate<double>(const QuantizedModel&, util::span<const std::vector<double>>, util::span<const int>, std::size_t, ThreadPool&);
+template Evaluation evaluate<float>(const SparseModel<float>&, util::span<const std::vector<float>>, util::span<const int>, std::size_t, ThreadPool&);
+template Evaluation evaluate<double>(const SparseModel<double>&, util::span<const std::vector<double>>, util::span<const int>, std::size_t, ThreadPool&);
+template Evaluation evaluate<float>(const SparseModel<float>&, const DatasetView&, std::size_t, ThreadPool&);
+template Evaluation evaluate<double>(const SparseModel<double>&, const DatasetView&, std::size_t, ThreadPool&);
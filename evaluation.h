@@ -0,0 +1,59 @@
+#pragma once
+
+#include "dataset.h"
+#include "model.h"
+#include "quantized_model.h"
+#include "sparse_model.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <vector>
+
+
+struct Evaluation
+{
+	std::size_t classes {};
+	std::size_t correct {};
+	std::size_t total {};
+	// confusion[expected * classes + predicted]
+	std::vector<std::size_t> confusion {};
+
+	double accuracy() const { return total ? double(correct) / total : 0.; }
+	std::size_t count(std::size_t expected, std::size_t predicted) const { return confusion[expected * classes + predicted]; }
+};
+
+
+// Classifies the inputs by the largest output in batches of batchSize samples,
+// which are spread over the pool and run through Model::predictBatch. All
+// overloads throw std::invalid_argument if inputs and labels differ in number
+// or a label isn't one of the model's classes.
+template <typename T>
+Evaluation evaluate(const Model<T>& model, util::nondeduced_t<util::span<const std::vector<T>>> inputs, util::span<const int> labels,
+					std::size_t batchSize = 256, ThreadPool& pool = ThreadPool::global());
+
+// The same for the samples of a view, normalized batch by batch.
+template <typename T>
+Evaluation evaluate(const Model<T>& model, const DatasetView& view, std::size_t batchSize = 256, ThreadPool& pool = ThreadPool::global());
+
+// The same for the int8 model, sample by sample within each batch.
+template <typename T>
+Evaluation evaluate(const QuantizedModel& model, util::span<const std::vector<T>> inputs, util::span<const int> labels,
+					std::size_t batchSize = 256, ThreadPool& pool = ThreadPool::global());
+
+// The same for the sparse model, sample by sample within each batch.
+template <typename T>
+Evaluation evaluate(const SparseModel<T>& model, util::nondeduced_t<util::span<const std::vector<T>>> inputs, util::span<const int> labels,
+					std::size_t batchSize = 256, ThreadPool& pool = ThreadPool::global());
+template <typename T>
+Evaluation evaluate(const SparseModel<T>& model, const DatasetView& view, std::size_t batchSize = 256, ThreadPool& pool = ThreadPool::global());
+
+extern template Evaluation evaluate<float>(const Model<float>&, util::span<const std::vector<float>>, util::span<const int>, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<double>(const Model<double>&, util::span<const std::vector<double>>, util::span<const int>, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<float>(const Model<float>&, const DatasetView&, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<double>(const Model<double>&, const DatasetView&, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<float>(const QuantizedModel&, util::span<const std::vector<float>>, util::span<const int>, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<double>(const QuantizedModel&, util::span<const std::vector<double>>, util::span<const int>, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<float>(const SparseModel<float>&, util::span<const std::vector<float>>, util::span<const int>, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<double>(const SparseModel<double>&, util::span<const std::vector<double>>, util::span<const int>, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<float>(const SparseModel<float>&, const DatasetView&, std::size_t, ThreadPool&);
+extern template Evaluation evaluate<double>(const SparseModel<double>&, const DatasetView&, std::size_t, ThreadPool&);
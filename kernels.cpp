@@ -0,0 +1,537 @@
+#include "kernels.h"
+
+#include "util.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if NEURAL_KERNELS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+	// Plain loops, used on CPUs without SSE2 and as the reference the SIMD paths are tested against.
+	namespace scalar
+	{
+		template <typename T>
+		void gemv(std::size_t rows, std::size_t cols, const T* A, std::size_t lda, const T* x, T* y)
+		{
+			for (std::size_t r {}; r < rows; r++)
+			{
+				T sum {};
+				for (std::size_t c {}; c < cols; c++)
+				{
+					sum += A[r * lda + c] * x[c];
+				}
+				y[r] += sum;
+			}
+		}
+
+		template <typename T>
+		void gemvT(std::size_t rows, std::size_t cols, const T* A, std::size_t lda, const T* x, T* y)
+		{
+			for (std::size_t r {}; r < rows; r++)
+			{
+				for (std::size_t c {}; c < cols; c++)
+				{
+					y[c] += A[r * lda + c] * x[r];
+				}
+			}
+		}
+
+		template <typename T>
+		void ger(std::size_t rows, std::size_t cols, T alpha, const T* x, const T* y, T* A, std::size_t lda)
+		{
+			for (std::size_t r {}; r < rows; r++)
+			{
+				for (std::size_t c {}; c < cols; c++)
+				{
+					A[r * lda + c] += alpha * x[r] * y[c];
+				}
+			}
+		}
+
+		template <typename T>
+		void gemm(kernels::Transpose transA, kernels::Transpose transB, std::size_t m, std::size_t n, std::size_t k,
+				  const T* A, std::size_t lda, const T* B, std::size_t ldb, T* C, std::size_t ldc, kernels::detail::GemmWorkspace<T>)
+		{
+			for (std::size_t i {}; i < m; i++)
+			{
+				for (std::size_t j {}; j < n; j++)
+				{
+					T sum {};
+					for (std::size_t p {}; p < k; p++)
+					{
+						const T a = transA == kernels::Transpose::No ? A[i * lda + p] : A[p * lda + i];
+						const T b = transB == kernels::Transpose::No ? B[p * ldb + j] : B[j * ldb + p];
+						sum += a * b;
+					}
+					C[i * ldc + j] += sum;
+				}
+			}
+		}
+
+		template <typename T>
+		void axpy(std::size_t n, T alpha, const T* x, T* y)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				y[i] += alpha * x[i];
+			}
+		}
+
+		template <typename T>
+		void multiply(std::size_t n, const T* x, T* y)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				y[i] *= x[i];
+			}
+		}
+
+		template <typename T>
+		void normalizeBytes(std::size_t n, const std::uint8_t* x, T divisor, T* y)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				y[i] = T(x[i]) / divisor;
+			}
+		}
+
+		template <typename T>
+		void csrGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns, const T* values, const T* x, T* y)
+		{
+			for (std::size_t r {}; r < rows; r++)
+			{
+				T sum {};
+				for (std::size_t k = offsets[r]; k < offsets[r + 1]; k++)
+				{
+					sum += values[k] * x[columns[k]];
+				}
+				y[r] += sum;
+			}
+		}
+
+		template <typename T>
+		void blockedGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns, const T* values, const T* x, T* y)
+		{
+			constexpr std::size_t Block = kernels::SparseBlock<T>;
+			for (std::size_t r {}; r < rows; r++)
+			{
+				T sum {};
+				for (std::size_t k = offsets[r]; k < offsets[r + 1]; k++)
+				{
+					for (std::size_t j {}; j < Block; j++)
+					{
+						sum += values[k * Block + j] * x[columns[k] + j];
+					}
+				}
+				y[r] += sum;
+			}
+		}
+
+		template <typename T>
+		void sigmoid(std::size_t n, const T* z, T* a)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				a[i] = T(1) / (T(1) + std::exp(-z[i]));
+			}
+		}
+
+		template <typename T>
+		void sigmoidWithDerivative(std::size_t n, const T* z, T* a, T* d)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				const T s = T(1) / (T(1) + std::exp(-z[i]));
+				a[i] = s;
+				d[i] = s * (T(1) - s);
+			}
+		}
+
+		template <typename T>
+		void rectifier(std::size_t n, T slope, const T* z, T* a)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				a[i] = z[i] < 0 ? slope * z[i] : z[i];
+			}
+		}
+
+		template <typename T>
+		void rectifierWithDerivative(std::size_t n, T slope, const T* z, T* a, T* d)
+		{
+			for (std::size_t i {}; i < n; i++)
+			{
+				a[i] = z[i] < 0 ? slope * z[i] : z[i];
+				d[i] = z[i] < 0 ? slope : T(1);
+			}
+		}
+
+		void gemvU8S8(std::size_t rows, std::size_t cols, const std::int8_t* A, std::size_t lda, const std::uint8_t* x, std::int32_t* y)
+		{
+			for (std::size_t r {}; r < rows; r++)
+			{
+				std::int32_t sum {};
+				for (std::size_t c {}; c < cols; c++)
+				{
+					sum += std::int32_t(A[r * lda + c]) * std::int32_t(x[c]);
+				}
+				y[r] += sum;
+			}
+		}
+	}
+
+#if NEURAL_KERNELS_X86
+	struct CpuidRegisters
+	{
+		unsigned eax {}, ebx {}, ecx {}, edx {};
+	};
+
+	CpuidRegisters cpuid(unsigned leaf, unsigned subleaf = 0)
+	{
+		CpuidRegisters r;
+#if defined(_MSC_VER)
+		int regs[4] {};
+		__cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+		r = { static_cast<unsigned>(regs[0]), static_cast<unsigned>(regs[1]), static_cast<unsigned>(regs[2]), static_cast<unsigned>(regs[3]) };
+#else
+		if (leaf <= __get_cpuid_max(0, nullptr))
+		{
+			__cpuid_count(leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
+		}
+#endif
+		return r;
+	}
+
+	unsigned long long xgetbv()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned eax {}, edx {};
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+#endif
+
+	bool cpuSupports(kernels::Isa isa)
+	{
+		if (isa == kernels::Isa::Scalar)
+		{
+			return true;
+		}
+#if NEURAL_KERNELS_X86
+		const auto leaf1 = cpuid(1);
+		const bool sse2 = leaf1.edx & (1u << 26);
+		if (isa == kernels::Isa::Sse2)
+		{
+			return sse2;
+		}
+
+		const bool osxsave = leaf1.ecx & (1u << 27);
+		const bool avx = leaf1.ecx & (1u << 28);
+		const bool fma = leaf1.ecx & (1u << 12);
+		if (!osxsave || !avx)
+		{
+			return false;
+		}
+		// the OS has to save ymm (and for AVX-512 also opmask and zmm) registers
+		const auto xcr0 = xgetbv();
+		const bool ymm_state = (xcr0 & 0x06) == 0x06;
+		const bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+		const auto leaf7 = cpuid(7);
+		const bool avx2 = leaf7.ebx & (1u << 5);
+		const bool avx512f = leaf7.ebx & (1u << 16);
+
+		if (isa == kernels::Isa::Avx2)
+		{
+			return ymm_state && avx2 && fma;
+		}
+		if (isa == kernels::Isa::Avx512)
+		{
+			return zmm_state && avx512f;
+		}
+#endif
+		return false;
+	}
+
+	bool cpuSupportsVnni()
+	{
+#if NEURAL_KERNELS_X86
+		const bool avx512_vnni = cpuid(7).ecx & (1u << 11);
+		return avx512_vnni && cpuSupports(kernels::Isa::Avx512);
+#else
+		return false;
+#endif
+	}
+
+	template <typename T>
+	const kernels::detail::Table<T>& tableFor(kernels::Isa isa)
+	{
+		switch (isa)
+		{
+#if NEURAL_KERNELS_X86
+		case kernels::Isa::Sse2: return kernels::detail::sse2Table<T>();
+		case kernels::Isa::Avx2: return kernels::detail::avx2Table<T>();
+		case kernels::Isa::Avx512: return kernels::detail::avx512Table<T>();
+#endif
+		default: return kernels::detail::scalarTable<T>();
+		}
+	}
+
+	kernels::detail::GemvU8S8 gemvU8S8For(kernels::Isa isa)
+	{
+		switch (isa)
+		{
+#if NEURAL_KERNELS_X86
+		case kernels::Isa::Sse2: return kernels::detail::sse2GemvU8S8();
+		case kernels::Isa::Avx2: return kernels::detail::avx2GemvU8S8();
+		// every CPU with AVX-512 also has AVX2
+		case kernels::Isa::Avx512: return cpuSupportsVnni() ? kernels::detail::avx512VnniGemvU8S8() : kernels::detail::avx2GemvU8S8();
+#endif
+		default: return &scalar::gemvU8S8;
+		}
+	}
+
+	kernels::Isa isaFromEnvironment(kernels::Isa detected)
+	{
+		const char* requested = std::getenv("NEURAL_ISA");
+		if (!requested)
+		{
+			return detected;
+		}
+		for (auto isa : { kernels::Isa::Scalar, kernels::Isa::Sse2, kernels::Isa::Avx2, kernels::Isa::Avx512 })
+		{
+			if (std::strcmp(requested, kernels::isaName(isa)) == 0 && kernels::isSupported(isa))
+			{
+				return isa;
+			}
+		}
+		return detected;
+	}
+
+	struct Dispatch
+	{
+		explicit Dispatch(kernels::Isa isa)
+			: isa(isa)
+			, floats(&tableFor<float>(isa))
+			, doubles(&tableFor<double>(isa))
+			, gemvU8S8(gemvU8S8For(isa))
+		{
+		}
+
+		template <typename T>
+		const kernels::detail::Table<T>& table() const;
+
+		kernels::Isa isa;
+		const kernels::detail::Table<float>* floats;
+		const kernels::detail::Table<double>* doubles;
+		kernels::detail::GemvU8S8 gemvU8S8;
+	};
+
+	template <>
+	const kernels::detail::Table<float>& Dispatch::table<float>() const
+	{
+		return *floats;
+	}
+
+	template <>
+	const kernels::detail::Table<double>& Dispatch::table<double>() const
+	{
+		return *doubles;
+	}
+
+	Dispatch& dispatch()
+	{
+		static Dispatch active { isaFromEnvironment(kernels::detectIsa()) };
+		return active;
+	}
+
+	template <typename T>
+	kernels::detail::GemmWorkspace<T> gemmWorkspace()
+	{
+		thread_local util::AlignedVector<T> packed_a(kernels::detail::Mc * kernels::detail::Kc);
+		thread_local util::AlignedVector<T> packed_b(kernels::detail::Kc * kernels::detail::Nc);
+		return { packed_a.data(), packed_b.data() };
+	}
+}
+
+namespace kernels
+{
+	Isa detectIsa()
+	{
+		for (auto isa : { Isa::Avx512, Isa::Avx2, Isa::Sse2 })
+		{
+			if (cpuSupports(isa))
+			{
+				return isa;
+			}
+		}
+		return Isa::Scalar;
+	}
+
+	Isa activeIsa()
+	{
+		return dispatch().isa;
+	}
+
+	bool isSupported(Isa isa)
+	{
+		return cpuSupports(isa);
+	}
+
+	void setIsa(Isa isa)
+	{
+		if (!isSupported(isa))
+		{
+			throw std::runtime_error(std::string("Instruction set not supported: ") + isaName(isa));
+		}
+		dispatch() = Dispatch{ isa };
+	}
+
+	const char* isaName(Isa isa)
+	{
+		switch (isa)
+		{
+		case Isa::Scalar: return "scalar";
+		case Isa::Sse2: return "sse2";
+		case Isa::Avx2: return "avx2";
+		case Isa::Avx512: return "avx512";
+		}
+		return "unknown";
+	}
+
+	template <typename T>
+	void gemv(std::size_t rows, std::size_t cols, const T* A, std::size_t lda, const T* x, T* y)
+	{
+		dispatch().table<T>().gemv(rows, cols, A, lda, x, y);
+	}
+
+	void gemvU8S8(std::size_t rows, std::size_t cols, const std::int8_t* A, std::size_t lda, const std::uint8_t* x, std::int32_t* y)
+	{
+		dispatch().gemvU8S8(rows, cols, A, lda, x, y);
+	}
+
+	bool usesVnni()
+	{
+		return activeIsa() == Isa::Avx512 && cpuSupportsVnni();
+	}
+
+	template <typename T>
+	void gemvT(std::size_t rows, std::size_t cols, const T* A, std::size_t lda, const T* x, T* y)
+	{
+		dispatch().table<T>().gemvT(rows, cols, A, lda, x, y);
+	}
+
+	template <typename T>
+	void ger(std::size_t rows, std::size_t cols, T alpha, const T* x, const T* y, T* A, std::size_t lda)
+	{
+		dispatch().table<T>().ger(rows, cols, alpha, x, y, A, lda);
+	}
+
+	template <typename T>
+	void gemm(Transpose transA, Transpose transB, std::size_t m, std::size_t n, std::size_t k,
+			  const T* A, std::size_t lda, const T* B, std::size_t ldb, T* C, std::size_t ldc)
+	{
+		dispatch().table<T>().gemm(transA, transB, m, n, k, A, lda, B, ldb, C, ldc, gemmWorkspace<T>());
+	}
+
+	template <typename T>
+	void axpy(std::size_t n, T alpha, const T* x, T* y)
+	{
+		dispatch().table<T>().axpy(n, alpha, x, y);
+	}
+
+	template <typename T>
+	void multiply(std::size_t n, const T* x, T* y)
+	{
+		dispatch().table<T>().multiply(n, x, y);
+	}
+
+	template <typename T>
+	void normalizeBytes(std::size_t n, const std::uint8_t* x, T divisor, T* y)
+	{
+		dispatch().table<T>().normalizeBytes(n, x, divisor, y);
+	}
+
+	template <typename T>
+	void csrGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns, const T* values, const T* x, T* y)
+	{
+		dispatch().table<T>().csrGemv(rows, offsets, columns, values, x, y);
+	}
+
+	template <typename T>
+	void blockedGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns, const T* values, const T* x, T* y)
+	{
+		dispatch().table<T>().blockedGemv(rows, offsets, columns, values, x, y);
+	}
+
+	template <typename T>
+	void sigmoid(std::size_t n, const T* z, T* a)
+	{
+		dispatch().table<T>().sigmoid(n, z, a);
+	}
+
+	template <typename T>
+	void sigmoidWithDerivative(std::size_t n, const T* z, T* a, T* d)
+	{
+		dispatch().table<T>().sigmoidWithDerivative(n, z, a, d);
+	}
+
+	template <typename T>
+	void rectifier(std::size_t n, T slope, const T* z, T* a)
+	{
+		dispatch().table<T>().rectifier(n, slope, z, a);
+	}
+
+	template <typename T>
+	void rectifierWithDerivative(std::size_t n, T slope, const T* z, T* a, T* d)
+	{
+		dispatch().table<T>().rectifierWithDerivative(n, slope, z, a, d);
+	}
+
+	template <typename T>
+	const detail::Table<T>& detail::scalarTable()
+	{
+		static const Table<T> table {
+			&scalar::gemv<T>, &scalar::gemvT<T>, &scalar::ger<T>, &scalar::gemm<T>, &scalar::axpy<T>, &scalar::multiply<T>,
+			&scalar::normalizeBytes<T>, &scalar::csrGemv<T>, &scalar::blockedGemv<T>,
+			&scalar::sigmoid<T>, &scalar::sigmoidWithDerivative<T>,
+			&scalar::rectifier<T>, &scalar::rectifierWithDerivative<T>
+		};
+		return table;
+	}
+
+#define NEURAL_KERNELS_INSTANTIATE(T) \
+	template void gemv<T>(std::size_t, std::size_t, const T*, std::size_t, const T*, T*); \
+	template void gemvT<T>(std::size_t, std::size_t, const T*, std::size_t, const T*, T*); \
+	template void ger<T>(std::size_t, std::size_t, T, const T*, const T*, T*, std::size_t); \
+	template void gemm<T>(Transpose, Transpose, std::size_t, std::size_t, std::size_t, const T*, std::size_t, const T*, std::size_t, T*, std::size_t); \
+	template void axpy<T>(std::size_t, T, const T*, T*); \
+	template void multiply<T>(std::size_t, const T*, T*); \
+	template void normalizeBytes<T>(std::size_t, const std::uint8_t*, T, T*); \
+	template void csrGemv<T>(std::size_t, const std::uint32_t*, const std::uint32_t*, const T*, const T*, T*); \
+	template void blockedGemv<T>(std::size_t, const std::uint32_t*, const std::uint32_t*, const T*, const T*, T*); \
+	template void sigmoid<T>(std::size_t, const T*, T*); \
+	template void sigmoidWithDerivative<T>(std::size_t, const T*, T*, T*); \
+	template void rectifier<T>(std::size_t, T, const T*, T*); \
+	template void rectifierWithDerivative<T>(std::size_t, T, const T*, T*, T*); \
+	template const detail::Table<T>& detail::scalarTable<T>();
+
+	NEURAL_KERNELS_INSTANTIATE(float)
+	NEURAL_KERNELS_INSTANTIATE(double)
+
+#undef NEURAL_KERNELS_INSTANTIATE
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NEURAL_KERNELS_X86 1
+#else
+#define NEURAL_KERNELS_X86 0
+#endif
+
+// Dense linear algebra used by Network. All matrices are row-major, `ld*` is the
+// distance (in elements) between consecutive rows. The implementation is picked
+// once at startup from CPUID (or the NEURAL_ISA environment variable) and can be
+// changed with setIsa().
+namespace kernels
+{
+	enum class Isa { Scalar, Sse2, Avx2, Avx512 };
+	enum class Transpose { No, Yes };
+
+	Isa detectIsa();
+	Isa activeIsa();
+	bool isSupported(Isa isa);
+	void setIsa(Isa isa);
+	const char* isaName(Isa isa);
+
+	// Instantiated for float and double.
+
+	// y += A * x, A is (rows x cols)
+	template <typename T>
+	void gemv(std::size_t rows, std::size_t cols, const T* A, std::size_t lda, const T* x, T* y);
+	// y += A^T * x, A is (rows x cols)
+	template <typename T>
+	void gemvT(std::size_t rows, std::size_t cols, const T* A, std::size_t lda, const T* x, T* y);
+	// A += alpha * x * y^T, A is (rows x cols)
+	template <typename T>
+	void ger(std::size_t rows, std::size_t cols, T alpha, const T* x, const T* y, T* A, std::size_t lda);
+	// C += op(A) * op(B), op(A) is (m x k), op(B) is (k x n), C is (m x n)
+	template <typename T>
+	void gemm(Transpose transA, Transpose transB, std::size_t m, std::size_t n, std::size_t k,
+			  const T* A, std::size_t lda, const T* B, std::size_t ldb, T* C, std::size_t ldc);
+	// y += alpha * x
+	template <typename T>
+	void axpy(std::size_t n, T alpha, const T* x, T* y);
+	// y *= x, elementwise
+	template <typename T>
+	void multiply(std::size_t n, const T* x, T* y);
+	// y = x / divisor, bytes such as pixels widened to T
+	template <typename T>
+	void normalizeBytes(std::size_t n, const std::uint8_t* x, T divisor, T* y);
+
+	// Sparse y += A * x, row r of A being the entries offsets[r] to offsets[r + 1] - 1.
+	// csrGemv: entry k is the value values[k] at column columns[k].
+	template <typename T>
+	void csrGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns, const T* values, const T* x, T* y);
+	// blockedGemv: entry k is the SparseBlock<T> values from values + k * SparseBlock<T>
+	// at the columns from columns[k] on. x has to be readable (and zero) up to
+	// the end of the last block.
+	template <typename T>
+	void blockedGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns, const T* values, const T* x, T* y);
+
+	// Width of a blockedGemv block: one cache line of values.
+	template <typename T>
+	constexpr std::size_t SparseBlock = 64 / sizeof(T);
+
+	// a = 1 / (1 + exp(-z)), elementwise
+	template <typename T>
+	void sigmoid(std::size_t n, const T* z, T* a);
+	// a = sigmoid(z), d = sigmoid'(z) = a * (1 - a), elementwise
+	template <typename T>
+	void sigmoidWithDerivative(std::size_t n, const T* z, T* a, T* d);
+	// a = z < 0 ? slope * z : z, elementwise (relu for slope 0)
+	template <typename T>
+	void rectifier(std::size_t n, T slope, const T* z, T* a);
+	// a = rectifier(z), d = (z < 0 ? slope : 1), elementwise
+	template <typename T>
+	void rectifierWithDerivative(std::size_t n, T slope, const T* z, T* a, T* d);
+
+	// y += A * x in exact 32-bit integer arithmetic, A is (rows x cols). x has to
+	// be within [0, 127] so the pairwise 16-bit sums of vpmaddubsw can't saturate.
+	void gemvU8S8(std::size_t rows, std::size_t cols, const std::int8_t* A, std::size_t lda, const std::uint8_t* x, std::int32_t* y);
+	// Whether gemvU8S8 runs on vpdpbusd (AVX-512 VNNI) under the active instruction set.
+	bool usesVnni();
+
+	namespace detail
+	{
+		// Cache blocking of gemm: a (Mc x Kc) block of op(A) is packed to stay in L2,
+		// a (Kc x Nc) block of op(B) is packed to stay in L3.
+		constexpr std::size_t Mc = 96;
+		constexpr std::size_t Kc = 256;
+		constexpr std::size_t Nc = 1024;
+		// Upper bound of the micro-tile sizes used by any instruction set.
+		constexpr std::size_t MaxMr = 8;
+		constexpr std::size_t MaxNr = 32;
+
+		template <typename T>
+		struct GemmWorkspace
+		{
+			T* packedA;
+			T* packedB;
+		};
+
+		template <typename T>
+		struct Table
+		{
+			void (*gemv)(std::size_t, std::size_t, const T*, std::size_t, const T*, T*);
+			void (*gemvT)(std::size_t, std::size_t, const T*, std::size_t, const T*, T*);
+			void (*ger)(std::size_t, std::size_t, T, const T*, const T*, T*, std::size_t);
+			void (*gemm)(Transpose, Transpose, std::size_t, std::size_t, std::size_t,
+						 const T*, std::size_t, const T*, std::size_t, T*, std::size_t, GemmWorkspace<T>);
+			void (*axpy)(std::size_t, T, const T*, T*);
+			void (*multiply)(std::size_t, const T*, T*);
+			void (*normalizeBytes)(std::size_t, const std::uint8_t*, T, T*);
+			void (*csrGemv)(std::size_t, const std::uint32_t*, const std::uint32_t*, const T*, const T*, T*);
+			void (*blockedGemv)(std::size_t, const std::uint32_t*, const std::uint32_t*, const T*, const T*, T*);
+			void (*sigmoid)(std::size_t, const T*, T*);
+			void (*sigmoidWithDerivative)(std::size_t, const T*, T*, T*);
+			void (*rectifier)(std::size_t, T, const T*, T*);
+			void (*rectifierWithDerivative)(std::size_t, T, const T*, T*, T*);
+		};
+
+		using GemvU8S8 = void (*)(std::size_t, std::size_t, const std::int8_t*, std::size_t, const std::uint8_t*, std::int32_t*);
+
+		template <typename T> const Table<T>& scalarTable();
+#if NEURAL_KERNELS_X86
+		template <typename T> const Table<T>& sse2Table();
+		template <typename T> const Table<T>& avx2Table();
+		template <typename T> const Table<T>& avx512Table();
+
+		GemvU8S8 sse2GemvU8S8();
+		GemvU8S8 avx2GemvU8S8();
+		GemvU8S8 avx512VnniGemvU8S8();
+#endif
+	}
+}
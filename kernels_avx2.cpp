@@ -0,0 +1,160 @@
+#include "kernels.h"
+
+#if NEURAL_KERNELS_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "kernels_simd.h"
+
+namespace
+{
+	template <typename T>
+	struct Avx2;
+
+	template <>
+	struct Avx2<float>
+	{
+		using value_type = float;
+		using reg = __m256;
+		static constexpr std::size_t lanes = 8;
+		static constexpr std::size_t mr = 4;
+
+		static reg zero() { return _mm256_setzero_ps(); }
+		static reg set1(float v) { return _mm256_set1_ps(v); }
+		static reg load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+		static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+		static float sum(reg v)
+		{
+			__m128 low = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+			low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+			return _mm_cvtss_f32(_mm_add_ss(low, _mm_shuffle_ps(low, low, 1)));
+		}
+		static reg gather(const float* p, const std::uint32_t* i)
+		{
+			return _mm256_i32gather_ps(p, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i)), 4);
+		}
+		static reg loadBytes(const std::uint8_t* p)
+		{
+			return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+		}
+		static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+		static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+		static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+		static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+		static reg selectNegative(reg z, reg a, reg b)
+		{
+			return _mm256_blendv_ps(b, a, _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		static reg scalePow2(reg p, reg t)
+		{
+			return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(p), _mm256_slli_epi32(_mm256_castps_si256(t), 23)));
+		}
+	};
+
+	template <>
+	struct Avx2<double>
+	{
+		using value_type = double;
+		using reg = __m256d;
+		static constexpr std::size_t lanes = 4;
+		static constexpr std::size_t mr = 4;
+
+		static reg zero() { return _mm256_setzero_pd(); }
+		static reg set1(double v) { return _mm256_set1_pd(v); }
+		static reg load(const double* p) { return _mm256_loadu_pd(p); }
+		static void store(double* p, reg v) { _mm256_storeu_pd(p, v); }
+		static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+		static double sum(reg v)
+		{
+			__m128d low = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+			return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+		}
+		static reg gather(const double* p, const std::uint32_t* i)
+		{
+			return _mm256_i32gather_pd(p, _mm_loadu_si128(reinterpret_cast<const __m128i*>(i)), 8);
+		}
+		static reg loadBytes(const std::uint8_t* p)
+		{
+			return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(p[0] | p[1] << 8 | p[2] << 16 | std::uint32_t(p[3]) << 24))));
+		}
+		static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+		static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+		static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+		static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+		static reg selectNegative(reg z, reg a, reg b)
+		{
+			return _mm256_blendv_pd(b, a, _mm256_cmp_pd(z, _mm256_setzero_pd(), _CMP_LT_OQ));
+		}
+		static reg scalePow2(reg p, reg t)
+		{
+			return _mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(p), _mm256_slli_epi64(_mm256_castpd_si256(t), 52)));
+		}
+	};
+}
+
+namespace
+{
+	void integerGemv(std::size_t rows, std::size_t cols, const std::int8_t* A, std::size_t lda, const std::uint8_t* x, std::int32_t* y)
+	{
+		const std::size_t vector_cols = cols - cols % 32;
+		const __m256i ones = _mm256_set1_epi16(1);
+
+		for (std::size_t r {}; r < rows; r++)
+		{
+			const std::int8_t* a = A + r * lda;
+			__m256i sum = _mm256_setzero_si256();
+			for (std::size_t c {}; c < vector_cols; c += 32)
+			{
+				const __m256i xv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + c));
+				const __m256i av = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + c));
+				// 16-bit sums of two u8 * s8 products, then 32-bit sums of two of those
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(xv, av), ones));
+			}
+			__m128i low = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+			low = _mm_add_epi32(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+			low = _mm_add_epi32(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			std::int32_t total = _mm_cvtsi128_si32(low);
+			for (std::size_t c = vector_cols; c < cols; c++)
+			{
+				total += std::int32_t(a[c]) * std::int32_t(x[c]);
+			}
+			y[r] += total;
+		}
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+template <typename T>
+const kernels::detail::Table<T>& kernels::detail::avx2Table()
+{
+	static const Table<T> table = simd::table<Avx2<T>>();
+	return table;
+}
+
+template const kernels::detail::Table<float>& kernels::detail::avx2Table<float>();
+template const kernels::detail::Table<double>& kernels::detail::avx2Table<double>();
+
+kernels::detail::GemvU8S8 kernels::detail::avx2GemvU8S8()
+{
+	return &integerGemv;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "kernels.h"
+
+#if NEURAL_KERNELS_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+#include "kernels_simd.h"
+
+namespace
+{
+	template <typename T>
+	struct Avx512;
+
+	template <>
+	struct Avx512<float>
+	{
+		using value_type = float;
+		using reg = __m512;
+		static constexpr std::size_t lanes = 16;
+		static constexpr std::size_t mr = 8;
+
+		static reg zero() { return _mm512_setzero_ps(); }
+		static reg set1(float v) { return _mm512_set1_ps(v); }
+		static reg load(const float* p) { return _mm512_loadu_ps(p); }
+		static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+		static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+		static float sum(reg v) { return _mm512_reduce_add_ps(v); }
+		static reg gather(const float* p, const std::uint32_t* i) { return _mm512_i32gather_ps(_mm512_loadu_si512(i), p, 4); }
+		static reg loadBytes(const std::uint8_t* p)
+		{
+			return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+		}
+		static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+		static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+		static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+		static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+		static reg selectNegative(reg z, reg a, reg b)
+		{
+			return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(z, _mm512_setzero_ps(), _CMP_LT_OQ), b, a);
+		}
+		static reg scalePow2(reg p, reg t)
+		{
+			return _mm512_castsi512_ps(_mm512_add_epi32(_mm512_castps_si512(p), _mm512_slli_epi32(_mm512_castps_si512(t), 23)));
+		}
+	};
+
+	template <>
+	struct Avx512<double>
+	{
+		using value_type = double;
+		using reg = __m512d;
+		static constexpr std::size_t lanes = 8;
+		static constexpr std::size_t mr = 8;
+
+		static reg zero() { return _mm512_setzero_pd(); }
+		static reg set1(double v) { return _mm512_set1_pd(v); }
+		static reg load(const double* p) { return _mm512_loadu_pd(p); }
+		static void store(double* p, reg v) { _mm512_storeu_pd(p, v); }
+		static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+		static double sum(reg v) { return _mm512_reduce_add_pd(v); }
+		static reg gather(const double* p, const std::uint32_t* i)
+		{
+			return _mm512_i32gather_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(i)), p, 8);
+		}
+		static reg loadBytes(const std::uint8_t* p)
+		{
+			return _mm512_cvtepi32_pd(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+		}
+		static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+		static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+		static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+		static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+		static reg selectNegative(reg z, reg a, reg b)
+		{
+			return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(z, _mm512_setzero_pd(), _CMP_LT_OQ), b, a);
+		}
+		static reg scalePow2(reg p, reg t)
+		{
+			return _mm512_castsi512_pd(_mm512_add_epi64(_mm512_castpd_si512(p), _mm512_slli_epi64(_mm512_castpd_si512(t), 52)));
+		}
+	};
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512vnni"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512vnni")
+#endif
+
+namespace
+{
+	void integerGemv(std::size_t rows, std::size_t cols, const std::int8_t* A, std::size_t lda, const std::uint8_t* x, std::int32_t* y)
+	{
+		const std::size_t vector_cols = cols - cols % 64;
+
+		for (std::size_t r {}; r < rows; r++)
+		{
+			const std::int8_t* a = A + r * lda;
+			__m512i sum = _mm512_setzero_si512();
+			for (std::size_t c {}; c < vector_cols; c += 64)
+			{
+				// four u8 * s8 products added straight into each 32-bit lane
+				sum = _mm512_dpbusd_epi32(sum, _mm512_loadu_si512(x + c), _mm512_loadu_si512(a + c));
+			}
+
+			std::int32_t total = _mm512_reduce_add_epi32(sum);
+			for (std::size_t c = vector_cols; c < cols; c++)
+			{
+				total += std::int32_t(a[c]) * std::int32_t(x[c]);
+			}
+			y[r] += total;
+		}
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+template <typename T>
+const kernels::detail::Table<T>& kernels::detail::avx512Table()
+{
+	static const Table<T> table = simd::table<Avx512<T>>();
+	return table;
+}
+
+template const kernels::detail::Table<float>& kernels::detail::avx512Table<float>();
+template const kernels::detail::Table<double>& kernels::detail::avx512Table<double>();
+
+kernels::detail::GemvU8S8 kernels::detail::avx512VnniGemvU8S8()
+{
+	return &integerGemv;
+}
+
+#endif
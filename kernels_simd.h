@@ -0,0 +1,654 @@
+#pragma once
+
+#include "kernels.h"
+
+// Blocked kernels written against a vector traits type V:
+//
+//   value_type, reg, lanes (elements per register), mr (micro-tile rows),
+//   zero(), set1(x), load(p), store(p, r), add(a, b), fmadd(a, b, c) = a * b + c, sum(r),
+//   gather(p, indices) = { p[indices[0]], p[indices[1]], ... },
+//   loadBytes(p) = lanes bytes from p widened to value_type,
+//   sub(a, b), mul(a, b), div(a, b), max(a, b), min(a, b),
+//   selectNegative(z, a, b) = z < 0 ? a : b,
+//   scalePow2(p, t) = p * 2^n for t = n + ExpConstants::magic
+//
+// Each kernels_<isa>.cpp includes this file after enabling its instruction set.
+// Everything here depends on V and nothing here uses the standard library, so
+// code generated for different targets is never merged by the linker.
+#if defined(__clang__)
+#define NEURAL_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define NEURAL_UNROLL _Pragma("GCC unroll 16")
+#else
+#define NEURAL_UNROLL
+#endif
+
+namespace kernels { namespace simd
+{
+	// Columns processed per pass of gemvT and ger, so the touched part of the
+	// vector stays in L1.
+	constexpr std::size_t ColumnBlock = 1024;
+
+	template <typename V>
+	void gemv(std::size_t rows, std::size_t cols, const typename V::value_type* A, std::size_t lda,
+			  const typename V::value_type* x, typename V::value_type* y)
+	{
+		using T = typename V::value_type;
+		const std::size_t vector_cols = cols - cols % V::lanes;
+
+		std::size_t r {};
+		for (; r + 4 <= rows; r += 4)
+		{
+			const T* a0 = A + r * lda;
+			const T* a1 = a0 + lda;
+			const T* a2 = a1 + lda;
+			const T* a3 = a2 + lda;
+
+			auto s0 = V::zero(), s1 = V::zero(), s2 = V::zero(), s3 = V::zero();
+			std::size_t c {};
+			for (; c < vector_cols; c += V::lanes)
+			{
+				const auto xv = V::load(x + c);
+				s0 = V::fmadd(V::load(a0 + c), xv, s0);
+				s1 = V::fmadd(V::load(a1 + c), xv, s1);
+				s2 = V::fmadd(V::load(a2 + c), xv, s2);
+				s3 = V::fmadd(V::load(a3 + c), xv, s3);
+			}
+
+			T t0 = V::sum(s0), t1 = V::sum(s1), t2 = V::sum(s2), t3 = V::sum(s3);
+			for (; c < cols; c++)
+			{
+				t0 += a0[c] * x[c];
+				t1 += a1[c] * x[c];
+				t2 += a2[c] * x[c];
+				t3 += a3[c] * x[c];
+			}
+
+			y[r] += t0;
+			y[r + 1] += t1;
+			y[r + 2] += t2;
+			y[r + 3] += t3;
+		}
+
+		for (; r < rows; r++)
+		{
+			const T* a0 = A + r * lda;
+			auto s0 = V::zero();
+			std::size_t c {};
+			for (; c < vector_cols; c += V::lanes)
+			{
+				s0 = V::fmadd(V::load(a0 + c), V::load(x + c), s0);
+			}
+			T t0 = V::sum(s0);
+			for (; c < cols; c++)
+			{
+				t0 += a0[c] * x[c];
+			}
+			y[r] += t0;
+		}
+	}
+
+	template <typename V>
+	void gemvT(std::size_t rows, std::size_t cols, const typename V::value_type* A, std::size_t lda,
+			   const typename V::value_type* x, typename V::value_type* y)
+	{
+		using T = typename V::value_type;
+
+		for (std::size_t c0 {}; c0 < cols; c0 += ColumnBlock)
+		{
+			const std::size_t c1 = c0 + ColumnBlock < cols ? c0 + ColumnBlock : cols;
+			const std::size_t vector_c1 = c0 + (c1 - c0) / V::lanes * V::lanes;
+
+			std::size_t r {};
+			for (; r + 4 <= rows; r += 4)
+			{
+				const T* a0 = A + r * lda;
+				const T* a1 = a0 + lda;
+				const T* a2 = a1 + lda;
+				const T* a3 = a2 + lda;
+				const auto x0 = V::set1(x[r]), x1 = V::set1(x[r + 1]), x2 = V::set1(x[r + 2]), x3 = V::set1(x[r + 3]);
+
+				std::size_t c = c0;
+				for (; c < vector_c1; c += V::lanes)
+				{
+					auto yv = V::load(y + c);
+					yv = V::fmadd(V::load(a0 + c), x0, yv);
+					yv = V::fmadd(V::load(a1 + c), x1, yv);
+					yv = V::fmadd(V::load(a2 + c), x2, yv);
+					yv = V::fmadd(V::load(a3 + c), x3, yv);
+					V::store(y + c, yv);
+				}
+				for (; c < c1; c++)
+				{
+					y[c] += a0[c] * x[r] + a1[c] * x[r + 1] + a2[c] * x[r + 2] + a3[c] * x[r + 3];
+				}
+			}
+
+			for (; r < rows; r++)
+			{
+				const T* a0 = A + r * lda;
+				const auto x0 = V::set1(x[r]);
+				std::size_t c = c0;
+				for (; c < vector_c1; c += V::lanes)
+				{
+					V::store(y + c, V::fmadd(V::load(a0 + c), x0, V::load(y + c)));
+				}
+				for (; c < c1; c++)
+				{
+					y[c] += a0[c] * x[r];
+				}
+			}
+		}
+	}
+
+	template <typename V>
+	void ger(std::size_t rows, std::size_t cols, typename V::value_type alpha, const typename V::value_type* x,
+			 const typename V::value_type* y, typename V::value_type* A, std::size_t lda)
+	{
+		using T = typename V::value_type;
+
+		for (std::size_t c0 {}; c0 < cols; c0 += ColumnBlock)
+		{
+			const std::size_t c1 = c0 + ColumnBlock < cols ? c0 + ColumnBlock : cols;
+			const std::size_t vector_c1 = c0 + (c1 - c0) / V::lanes * V::lanes;
+
+			for (std::size_t r {}; r < rows; r++)
+			{
+				T* row = A + r * lda;
+				const T scale = alpha * x[r];
+				const auto scale_v = V::set1(scale);
+
+				std::size_t c = c0;
+				for (; c < vector_c1; c += V::lanes)
+				{
+					V::store(row + c, V::fmadd(scale_v, V::load(y + c), V::load(row + c)));
+				}
+				for (; c < c1; c++)
+				{
+					row[c] += scale * y[c];
+				}
+			}
+		}
+	}
+
+	template <typename V>
+	void axpy(std::size_t n, typename V::value_type alpha, const typename V::value_type* x, typename V::value_type* y)
+	{
+		const auto alpha_v = V::set1(alpha);
+		const std::size_t vector_n = n - n % (2 * V::lanes);
+
+		std::size_t i {};
+		for (; i < vector_n; i += 2 * V::lanes)
+		{
+			V::store(y + i, V::fmadd(alpha_v, V::load(x + i), V::load(y + i)));
+			V::store(y + i + V::lanes, V::fmadd(alpha_v, V::load(x + i + V::lanes), V::load(y + i + V::lanes)));
+		}
+		for (; i < n; i++)
+		{
+			y[i] += alpha * x[i];
+		}
+	}
+
+	template <typename V>
+	void csrGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns,
+				 const typename V::value_type* values, const typename V::value_type* x, typename V::value_type* y)
+	{
+		using T = typename V::value_type;
+
+		for (std::size_t r {}; r < rows; r++)
+		{
+			const std::size_t end = offsets[r + 1];
+			std::size_t k = offsets[r];
+
+			// two chains, so one gather waits while the other multiplies
+			auto s0 = V::zero(), s1 = V::zero();
+			for (; k + 2 * V::lanes <= end; k += 2 * V::lanes)
+			{
+				s0 = V::fmadd(V::load(values + k), V::gather(x, columns + k), s0);
+				s1 = V::fmadd(V::load(values + k + V::lanes), V::gather(x, columns + k + V::lanes), s1);
+			}
+			for (; k + V::lanes <= end; k += V::lanes)
+			{
+				s0 = V::fmadd(V::load(values + k), V::gather(x, columns + k), s0);
+			}
+
+			T t = V::sum(V::add(s0, s1));
+			for (; k < end; k++)
+			{
+				t += values[k] * x[columns[k]];
+			}
+			y[r] += t;
+		}
+	}
+
+	template <typename V>
+	void blockedGemv(std::size_t rows, const std::uint32_t* offsets, const std::uint32_t* columns,
+					 const typename V::value_type* values, const typename V::value_type* x, typename V::value_type* y)
+	{
+		using T = typename V::value_type;
+		constexpr std::size_t Block = SparseBlock<T>;
+		static_assert(Block % V::lanes == 0, "a sparse block has to hold whole registers");
+
+		for (std::size_t r {}; r < rows; r++)
+		{
+			auto s = V::zero();
+			for (std::size_t k = offsets[r]; k < offsets[r + 1]; k++)
+			{
+				const T* block = values + k * Block;
+				const T* xb = x + columns[k];
+				NEURAL_UNROLL
+				for (std::size_t j {}; j < Block; j += V::lanes)
+				{
+					s = V::fmadd(V::load(block + j), V::load(xb + j), s);
+				}
+			}
+			y[r] += V::sum(s);
+		}
+	}
+
+	// Copies the (mc x kc) block of op(A) at (i0, k0) into panels of V::mr rows,
+	// each stored column by column; missing rows of the last panel are zeroed.
+	template <typename V>
+	void packA(Transpose transA, const typename V::value_type* A, std::size_t lda,
+			   std::size_t i0, std::size_t mc, std::size_t k0, std::size_t kc, typename V::value_type* packed)
+	{
+		constexpr std::size_t Mr = V::mr;
+		for (std::size_t p {}; p < mc; p += Mr)
+		{
+			const std::size_t rows = mc - p < Mr ? mc - p : Mr;
+			for (std::size_t kk {}; kk < kc; kk++)
+			{
+				std::size_t i {};
+				for (; i < rows; i++)
+				{
+					const std::size_t row = i0 + p + i;
+					const std::size_t col = k0 + kk;
+					packed[i] = transA == Transpose::No ? A[row * lda + col] : A[col * lda + row];
+				}
+				for (; i < Mr; i++)
+				{
+					packed[i] = {};
+				}
+				packed += Mr;
+			}
+		}
+	}
+
+	// Copies the (kc x nc) block of op(B) at (k0, j0) into panels of 2 * V::lanes
+	// columns, each stored row by row; missing columns of the last panel are zeroed.
+	template <typename V>
+	void packB(Transpose transB, const typename V::value_type* B, std::size_t ldb,
+			   std::size_t k0, std::size_t kc, std::size_t j0, std::size_t nc, typename V::value_type* packed)
+	{
+		constexpr std::size_t Nr = 2 * V::lanes;
+		for (std::size_t p {}; p < nc; p += Nr)
+		{
+			const std::size_t cols = nc - p < Nr ? nc - p : Nr;
+			for (std::size_t kk {}; kk < kc; kk++)
+			{
+				std::size_t j {};
+				for (; j < cols; j++)
+				{
+					const std::size_t row = k0 + kk;
+					const std::size_t col = j0 + p + j;
+					packed[j] = transB == Transpose::No ? B[row * ldb + col] : B[col * ldb + row];
+				}
+				for (; j < Nr; j++)
+				{
+					packed[j] = {};
+				}
+				packed += Nr;
+			}
+		}
+	}
+
+	// C(mr x nr) += packed A panel * packed B panel, accumulated in V::mr x 2 registers.
+	template <typename V>
+	void microKernel(std::size_t kc, const typename V::value_type* a, const typename V::value_type* b,
+					 typename V::value_type* C, std::size_t ldc, std::size_t mr, std::size_t nr)
+	{
+		using T = typename V::value_type;
+		constexpr std::size_t Mr = V::mr;
+		constexpr std::size_t Nr = 2 * V::lanes;
+
+		typename V::reg c0[Mr];
+		typename V::reg c1[Mr];
+		NEURAL_UNROLL
+		for (std::size_t i {}; i < Mr; i++)
+		{
+			c0[i] = V::zero();
+			c1[i] = V::zero();
+		}
+
+		for (std::size_t kk {}; kk < kc; kk++)
+		{
+			const auto b0 = V::load(b);
+			const auto b1 = V::load(b + V::lanes);
+			NEURAL_UNROLL
+			for (std::size_t i {}; i < Mr; i++)
+			{
+				const auto av = V::set1(a[i]);
+				c0[i] = V::fmadd(av, b0, c0[i]);
+				c1[i] = V::fmadd(av, b1, c1[i]);
+			}
+			a += Mr;
+			b += Nr;
+		}
+
+		if (mr == Mr && nr == Nr)
+		{
+			NEURAL_UNROLL
+			for (std::size_t i {}; i < Mr; i++)
+			{
+				T* row = C + i * ldc;
+				V::store(row, V::add(V::load(row), c0[i]));
+				V::store(row + V::lanes, V::add(V::load(row + V::lanes), c1[i]));
+			}
+			return;
+		}
+
+		T tile[Mr * Nr];
+		NEURAL_UNROLL
+		for (std::size_t i {}; i < Mr; i++)
+		{
+			V::store(tile + i * Nr, c0[i]);
+			V::store(tile + i * Nr + V::lanes, c1[i]);
+		}
+		for (std::size_t i {}; i < mr; i++)
+		{
+			for (std::size_t j {}; j < nr; j++)
+			{
+				C[i * ldc + j] += tile[i * Nr + j];
+			}
+		}
+	}
+
+	template <typename V>
+	void gemm(Transpose transA, Transpose transB, std::size_t m, std::size_t n, std::size_t k,
+			  const typename V::value_type* A, std::size_t lda, const typename V::value_type* B, std::size_t ldb,
+			  typename V::value_type* C, std::size_t ldc, detail::GemmWorkspace<typename V::value_type> workspace)
+	{
+		constexpr std::size_t Mr = V::mr;
+		constexpr std::size_t Nr = 2 * V::lanes;
+		static_assert(Mr <= detail::MaxMr && Nr <= detail::MaxNr, "micro-tile does not fit the gemm workspace");
+		static_assert(detail::Mc % Mr == 0 && detail::Nc % Nr == 0, "cache blocks must hold whole micro-tiles");
+
+		for (std::size_t j0 {}; j0 < n; j0 += detail::Nc)
+		{
+			const std::size_t nc = n - j0 < detail::Nc ? n - j0 : detail::Nc;
+			for (std::size_t k0 {}; k0 < k; k0 += detail::Kc)
+			{
+				const std::size_t kc = k - k0 < detail::Kc ? k - k0 : detail::Kc;
+				packB<V>(transB, B, ldb, k0, kc, j0, nc, workspace.packedB);
+
+				for (std::size_t i0 {}; i0 < m; i0 += detail::Mc)
+				{
+					const std::size_t mc = m - i0 < detail::Mc ? m - i0 : detail::Mc;
+					packA<V>(transA, A, lda, i0, mc, k0, kc, workspace.packedA);
+
+					for (std::size_t jr {}; jr < nc; jr += Nr)
+					{
+						const std::size_t nr = nc - jr < Nr ? nc - jr : Nr;
+						for (std::size_t ir {}; ir < mc; ir += Mr)
+						{
+							const std::size_t mr = mc - ir < Mr ? mc - ir : Mr;
+							microKernel<V>(kc, workspace.packedA + ir * kc, workspace.packedB + jr * kc,
+										   C + (i0 + ir) * ldc + j0 + jr, ldc, mr, nr);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	template <typename T>
+	struct ExpConstants;
+
+	template <>
+	struct ExpConstants<double>
+	{
+		// arguments are clamped so that the result stays a normal number
+		static constexpr double min = -700.;
+		static constexpr double max = 700.;
+		// 1.5 * 2^52: adding it rounds to an integer held in the low mantissa bits
+		static constexpr double magic = 6755399441055744.;
+		static constexpr double log2e = 1.4426950408889634;
+		static constexpr double ln2High = 6.93145751953125e-1;
+		static constexpr double ln2Low = 1.42860682030941723212e-6;
+		// Taylor series of exp(r) for |r| <= ln(2) / 2, highest order first
+		static constexpr int degree = 11;
+		static constexpr double coefficients[degree + 1] = {
+			1. / 39916800, 1. / 3628800, 1. / 362880, 1. / 40320, 1. / 5040, 1. / 720,
+			1. / 120, 1. / 24, 1. / 6, 1. / 2, 1., 1.
+		};
+	};
+
+	template <>
+	struct ExpConstants<float>
+	{
+		static constexpr float min = -80.f;
+		static constexpr float max = 80.f;
+		// 1.5 * 2^23
+		static constexpr float magic = 12582912.f;
+		static constexpr float log2e = 1.44269504f;
+		static constexpr float ln2High = 0.693359375f;
+		static constexpr float ln2Low = -2.12194440e-4f;
+		static constexpr int degree = 7;
+		static constexpr float coefficients[degree + 1] = {
+			1.f / 5040, 1.f / 720, 1.f / 120, 1.f / 24, 1.f / 6, 1.f / 2, 1.f, 1.f
+		};
+	};
+
+	// exp(x) = 2^n * exp(r) with n = round(x / ln 2) and r = x - n * ln 2
+	template <typename V>
+	typename V::reg exp(typename V::reg x)
+	{
+		using Constants = ExpConstants<typename V::value_type>;
+
+		x = V::min(V::max(x, V::set1(Constants::min)), V::set1(Constants::max));
+
+		const auto magic = V::set1(Constants::magic);
+		const auto t = V::fmadd(x, V::set1(Constants::log2e), magic);
+		const auto n = V::sub(t, magic);
+
+		auto r = V::sub(x, V::mul(n, V::set1(Constants::ln2High)));
+		r = V::sub(r, V::mul(n, V::set1(Constants::ln2Low)));
+
+		auto p = V::set1(Constants::coefficients[0]);
+		NEURAL_UNROLL
+		for (int i = 1; i <= Constants::degree; i++)
+		{
+			p = V::fmadd(p, r, V::set1(Constants::coefficients[i]));
+		}
+
+		return V::scalePow2(p, t);
+	}
+
+	// inout[i] = f(z[i], inout[i]) for a function of two registers; the
+	// remainder is processed in a zero-padded register as well.
+	template <typename V, typename Function>
+	void transform(std::size_t n, const typename V::value_type* z, typename V::value_type* inout, Function f)
+	{
+		using T = typename V::value_type;
+		const std::size_t vector_n = n - n % V::lanes;
+
+		std::size_t i {};
+		for (; i < vector_n; i += V::lanes)
+		{
+			V::store(inout + i, f(V::load(z + i), V::load(inout + i)));
+		}
+		if (i == n)
+		{
+			return;
+		}
+
+		T z_tail[V::lanes] {};
+		T inout_tail[V::lanes] {};
+		for (std::size_t j {}; i + j < n; j++)
+		{
+			z_tail[j] = z[i + j];
+			inout_tail[j] = inout[i + j];
+		}
+		V::store(inout_tail, f(V::load(z_tail), V::load(inout_tail)));
+		for (std::size_t j {}; i + j < n; j++)
+		{
+			inout[i + j] = inout_tail[j];
+		}
+	}
+
+	// a[i], d[i] = f(z[i]) for a function writing two registers
+	template <typename V, typename Function>
+	void transform(std::size_t n, const typename V::value_type* z, typename V::value_type* a, typename V::value_type* d, Function f)
+	{
+		using T = typename V::value_type;
+		const std::size_t vector_n = n - n % V::lanes;
+
+		typename V::reg av, dv;
+		std::size_t i {};
+		for (; i < vector_n; i += V::lanes)
+		{
+			f(V::load(z + i), av, dv);
+			V::store(a + i, av);
+			V::store(d + i, dv);
+		}
+		if (i == n)
+		{
+			return;
+		}
+
+		T z_tail[V::lanes] {};
+		T a_tail[V::lanes];
+		T d_tail[V::lanes];
+		for (std::size_t j {}; i + j < n; j++)
+		{
+			z_tail[j] = z[i + j];
+		}
+		f(V::load(z_tail), av, dv);
+		V::store(a_tail, av);
+		V::store(d_tail, dv);
+		for (std::size_t j {}; i + j < n; j++)
+		{
+			a[i + j] = a_tail[j];
+			d[i + j] = d_tail[j];
+		}
+	}
+
+	template <typename V>
+	typename V::reg sigmoid(typename V::reg z)
+	{
+		const auto one = V::set1(1);
+		return V::div(one, V::add(one, exp<V>(V::sub(V::zero(), z))));
+	}
+
+	// The elementwise operations are function objects rather than lambdas: a
+	// lambda's call operator does not pick up the target pragma of the ISA file.
+	template <typename V>
+	struct SigmoidForward
+	{
+		typename V::reg operator()(typename V::reg z, typename V::reg) const
+		{
+			return sigmoid<V>(z);
+		}
+	};
+
+	template <typename V>
+	struct SigmoidWithDerivative
+	{
+		void operator()(typename V::reg z, typename V::reg& a, typename V::reg& d) const
+		{
+			a = sigmoid<V>(z);
+			d = V::mul(a, V::sub(V::set1(1), a));
+		}
+	};
+
+	template <typename V>
+	struct RectifierForward
+	{
+		typename V::reg slope;
+
+		typename V::reg operator()(typename V::reg z, typename V::reg) const
+		{
+			return V::fmadd(slope, V::min(z, V::zero()), V::max(z, V::zero()));
+		}
+	};
+
+	template <typename V>
+	struct RectifierWithDerivative
+	{
+		typename V::reg slope;
+
+		void operator()(typename V::reg z, typename V::reg& a, typename V::reg& d) const
+		{
+			a = V::fmadd(slope, V::min(z, V::zero()), V::max(z, V::zero()));
+			d = V::selectNegative(z, slope, V::set1(1));
+		}
+	};
+
+	template <typename V>
+	struct Multiply
+	{
+		typename V::reg operator()(typename V::reg x, typename V::reg y) const
+		{
+			return V::mul(x, y);
+		}
+	};
+
+	template <typename V>
+	void multiply(std::size_t n, const typename V::value_type* x, typename V::value_type* y)
+	{
+		transform<V>(n, x, y, Multiply<V> {});
+	}
+
+	template <typename V>
+	void normalizeBytes(std::size_t n, const std::uint8_t* x, typename V::value_type divisor, typename V::value_type* y)
+	{
+		using T = typename V::value_type;
+		const std::size_t vector_n = n - n % V::lanes;
+		const auto d = V::set1(divisor);
+
+		std::size_t i {};
+		for (; i < vector_n; i += V::lanes)
+		{
+			V::store(y + i, V::div(V::loadBytes(x + i), d));
+		}
+		for (; i < n; i++)
+		{
+			y[i] = T(x[i]) / divisor;
+		}
+	}
+
+	template <typename V>
+	void sigmoid(std::size_t n, const typename V::value_type* z, typename V::value_type* a)
+	{
+		transform<V>(n, z, a, SigmoidForward<V> {});
+	}
+
+	template <typename V>
+	void sigmoidWithDerivative(std::size_t n, const typename V::value_type* z, typename V::value_type* a, typename V::value_type* d)
+	{
+		transform<V>(n, z, a, d, SigmoidWithDerivative<V> {});
+	}
+
+	template <typename V>
+	void rectifier(std::size_t n, typename V::value_type slope, const typename V::value_type* z, typename V::value_type* a)
+	{
+		transform<V>(n, z, a, RectifierForward<V> { V::set1(slope) });
+	}
+
+	template <typename V>
+	void rectifierWithDerivative(std::size_t n, typename V::value_type slope, const typename V::value_type* z, typename V::value_type* a, typename V::value_type* d)
+	{
+		transform<V>(n, z, a, d, RectifierWithDerivative<V> { V::set1(slope) });
+	}
+
+	template <typename V>
+	detail::Table<typename V::value_type> table()
+	{
+		return {
+			&gemv<V>, &gemvT<V>, &ger<V>, &gemm<V>, &axpy<V>, &multiply<V>, &normalizeBytes<V>, &csrGemv<V>, &blockedGemv<V>,
+			&sigmoid<V>, &sigmoidWithDerivative<V>,
+			&rectifier<V>, &rectifierWithDerivative<V>
+		};
+	}
+
+} }
@@ -0,0 +1,154 @@
+#include "kernels.h"
+
+#if NEURAL_KERNELS_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#include "kernels_simd.h"
+
+namespace
+{
+	template <typename T>
+	struct Sse2;
+
+	template <>
+	struct Sse2<float>
+	{
+		using value_type = float;
+		using reg = __m128;
+		static constexpr std::size_t lanes = 4;
+		static constexpr std::size_t mr = 4;
+
+		static reg zero() { return _mm_setzero_ps(); }
+		static reg set1(float v) { return _mm_set1_ps(v); }
+		static reg load(const float* p) { return _mm_loadu_ps(p); }
+		static void store(float* p, reg v) { _mm_storeu_ps(p, v); }
+		static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static float sum(reg v)
+		{
+			v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+			return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+		}
+		static reg gather(const float* p, const std::uint32_t* i) { return _mm_set_ps(p[i[3]], p[i[2]], p[i[1]], p[i[0]]); }
+		static reg loadBytes(const std::uint8_t* p)
+		{
+			const __m128i bytes = _mm_cvtsi32_si128(int(p[0] | p[1] << 8 | p[2] << 16 | std::uint32_t(p[3]) << 24));
+			const __m128i zero = _mm_setzero_si128();
+			return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+		}
+		static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+		static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+		static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+		static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+		static reg selectNegative(reg z, reg a, reg b)
+		{
+			const reg negative = _mm_cmplt_ps(z, _mm_setzero_ps());
+			return _mm_or_ps(_mm_and_ps(negative, a), _mm_andnot_ps(negative, b));
+		}
+		static reg scalePow2(reg p, reg t)
+		{
+			return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), _mm_slli_epi32(_mm_castps_si128(t), 23)));
+		}
+	};
+
+	template <>
+	struct Sse2<double>
+	{
+		using value_type = double;
+		using reg = __m128d;
+		static constexpr std::size_t lanes = 2;
+		static constexpr std::size_t mr = 4;
+
+		static reg zero() { return _mm_setzero_pd(); }
+		static reg set1(double v) { return _mm_set1_pd(v); }
+		static reg load(const double* p) { return _mm_loadu_pd(p); }
+		static void store(double* p, reg v) { _mm_storeu_pd(p, v); }
+		static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+		static double sum(reg v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+		static reg gather(const double* p, const std::uint32_t* i) { return _mm_set_pd(p[i[1]], p[i[0]]); }
+		static reg loadBytes(const std::uint8_t* p) { return _mm_cvtepi32_pd(_mm_set_epi32(0, 0, p[1], p[0])); }
+		static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+		static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+		static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+		static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+		static reg selectNegative(reg z, reg a, reg b)
+		{
+			const reg negative = _mm_cmplt_pd(z, _mm_setzero_pd());
+			return _mm_or_pd(_mm_and_pd(negative, a), _mm_andnot_pd(negative, b));
+		}
+		static reg scalePow2(reg p, reg t)
+		{
+			return _mm_castsi128_pd(_mm_add_epi64(_mm_castpd_si128(p), _mm_slli_epi64(_mm_castpd_si128(t), 52)));
+		}
+	};
+}
+
+namespace
+{
+	void integerGemv(std::size_t rows, std::size_t cols, const std::int8_t* A, std::size_t lda, const std::uint8_t* x, std::int32_t* y)
+	{
+		const std::size_t vector_cols = cols - cols % 16;
+		const __m128i zero = _mm_setzero_si128();
+
+		for (std::size_t r {}; r < rows; r++)
+		{
+			const std::int8_t* a = A + r * lda;
+			__m128i sum = zero;
+			for (std::size_t c {}; c < vector_cols; c += 16)
+			{
+				const __m128i xv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + c));
+				const __m128i av = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + c));
+				// no byte multiply before SSSE3: zero extend x and sign extend A to 16 bits
+				const __m128i x_low = _mm_unpacklo_epi8(xv, zero);
+				const __m128i x_high = _mm_unpackhi_epi8(xv, zero);
+				const __m128i a_low = _mm_srai_epi16(_mm_unpacklo_epi8(av, av), 8);
+				const __m128i a_high = _mm_srai_epi16(_mm_unpackhi_epi8(av, av), 8);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(x_low, a_low));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(x_high, a_high));
+			}
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			std::int32_t total = _mm_cvtsi128_si32(sum);
+			for (std::size_t c = vector_cols; c < cols; c++)
+			{
+				total += std::int32_t(a[c]) * std::int32_t(x[c]);
+			}
+			y[r] += total;
+		}
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+template <typename T>
+const kernels::detail::Table<T>& kernels::detail::sse2Table()
+{
+	static const Table<T> table = simd::table<Sse2<T>>();
+	return table;
+}
+
+template const kernels::detail::Table<float>& kernels::detail::sse2Table<float>();
+template const kernels::detail::Table<double>& kernels::detail::sse2Table<double>();
+
+kernels::detail::GemvU8S8 kernels::detail::sse2GemvU8S8()
+{
+	return &integerGemv;
+}
+
+#endif
@@ -1,6 +1,36 @@
 #include "network_runner.h"
 
+#include <string>
+
 int main(int argc, char* argv[])
 {
+	const std::string mode = argc > 1 ? argv[1] : "";
+
+	if (mode == "precision")
+	{
+		run_precision_comparison();
+		return 0;
+	}
+	if (mode == "hogwild")
+	{
+		run_hogwild_benchmark();
+		return 0;
+	}
+	if (mode == "pruning")
+	{
+		run_pruning_benchmark();
+		return 0;
+	}
+	if (mode == "static")
+	{
+		run_static_network();
+		return 0;
+	}
+	if (mode == "saved")
+	{
+		run_saved_model();
+		return 0;
+	}
+
 	run_dynamic_network();
 }
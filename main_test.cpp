@@ -2,9 +2,89 @@
 #include "doctest.h"
 
 #include "network.h"
+#include "model.h"
+#include "model_export.h"
+#include "quantized_model.h"
+#include "sparse_model.h"
+#include "pruning.h"
+#include "checkpoint.h"
+#include "batch_pipeline.h"
+#include "evaluation.h"
+#include "parallel_trainer.h"
+#include "thread_pool.h"
+#include "activation.h"
+#include "kernels.h"
 #include "util.h"
 #include "mnist_reader.h"
 
+#include "static_network.h"
+// exportHeader's output for the network in "exported header predicts like the model"
+#include "model_export_fixture.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+// Every heap allocation of the test binary is counted, so tests can check
+// that a code path does not allocate.
+namespace
+{
+	std::atomic<std::size_t> allocations {};
+
+	void* allocate(std::size_t size, std::size_t alignment)
+	{
+		allocations++;
+		size = size ? size : 1;
+#ifdef _WIN32
+		void* p = _aligned_malloc(size, alignment);
+#else
+		void* p {};
+		if (posix_memalign(&p, std::max(alignment, sizeof(void*)), size) != 0)
+		{
+			p = nullptr;
+		}
+#endif
+		if (!p)
+		{
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+	void release(void* p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
+void* operator new(std::size_t size) { return allocate(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return allocate(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocate(size, std::size_t(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocate(size, std::size_t(alignment)); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { release(p); }
+
 TEST_CASE("random")
 {
 	auto r1 = util::randomNormal(), r2 = util::randomNormal();
@@ -31,11 +111,327 @@ TEST_CASE("architecture")
 	auto arch = n.architecture();
 	CHECK(arch.size() == 3);
 	CHECK(arch == std::vector<std::size_t>{2, 3, 4});
-	CHECK(n.layers[1].neurons[0].weights[0] != n.layers[1].neurons[1].weights[0]);
+	CHECK(n.layers[1].neuron(0).weights[0] != n.layers[1].neuron(1).weights[0]);
 
 	CHECK_THROWS(Network{{}});
 }
 
+TEST_CASE("layer layout")
+{
+	Network n({3, 2});
+	auto& layer = n.layers[1];
+	CHECK(layer.weights.size() == 6);
+	CHECK(reinterpret_cast<std::uintptr_t>(layer.weights.data()) % util::CacheLineSize == 0);
+
+	layer.neuron(1).weights[2] = 4.0;
+	CHECK(layer.weights[1 * 3 + 2] == 4.0);
+	layer.neuron(1).bias = 2.0;
+	CHECK(layer.biases[1] == 2.0);
+}
+
+TEST_CASE("network arena")
+{
+	Network n({5, 4, 3}, Activation::Sigmoid);
+	const auto parameters = n.parameters();
+
+	for (std::size_t layer {}; layer < n.layers.size(); layer++)
+	{
+		for (const auto& array : { n.layers[layer].weights, n.layers[layer].biases, n.layers[layer].activations, n.layers[layer].errors, n.corrections[layer].weights })
+		{
+			CHECK(reinterpret_cast<std::uintptr_t>(array.data()) % util::CacheLineSize == 0);
+		}
+		CHECK(n.layers[layer].weights.data() >= parameters.data());
+		CHECK(n.layers[layer].biases.end() <= parameters.end());
+	}
+
+	SUBCASE("copies own their arrays")
+	{
+		Network copy = n;
+		CHECK(copy.layers[1].weights.data() != n.layers[1].weights.data());
+		CHECK(std::equal(parameters.begin(), parameters.end(), copy.parameters().begin()));
+
+		copy.layers[1].weights[0] += 1;
+		copy.learnOnce({ 1, 0, 1, 0, 1 }, 2);
+		CHECK(copy.layers[1].weights[0] != n.layers[1].weights[0]);
+		CHECK(copy.feedForward({ 1, 0, 1, 0, 1 }) != n.feedForward({ 1, 0, 1, 0, 1 }));
+
+		n = copy;
+		CHECK(n.layers[1].weights.data() != copy.layers[1].weights.data());
+		CHECK(n.feedForward({ 1, 0, 1, 0, 1 }) == copy.feedForward({ 1, 0, 1, 0, 1 }));
+	}
+
+	SUBCASE("huge pages")
+	{
+		util::Arena<float> arena(util::HugePageSize, true);
+		CHECK(arena.hugePages());
+		CHECK(reinterpret_cast<std::uintptr_t>(arena.data()) % util::HugePageSize == 0);
+		CHECK(std::all_of(arena.data(), arena.data() + arena.size(), [](float value) { return value == 0; }));
+
+		CHECK_FALSE(util::Arena<float>(16, true).hugePages());
+	}
+}
+
+namespace
+{
+	template <typename T, typename Function>
+	void compareWithScalar(Function run)
+	{
+		const auto active = kernels::activeIsa();
+
+		kernels::setIsa(kernels::Isa::Scalar);
+		const auto expected = run();
+
+		for (auto isa : { kernels::Isa::Sse2, kernels::Isa::Avx2, kernels::Isa::Avx512 })
+		{
+			if (!kernels::isSupported(isa))
+			{
+				continue;
+			}
+			kernels::setIsa(isa);
+			const auto result = run();
+
+			const std::string name = kernels::isaName(isa);
+			INFO(name);
+			REQUIRE(result.size() == expected.size());
+			for (std::size_t i {}; i < result.size(); i++)
+			{
+				CHECK(result[i] == doctest::Approx(expected[i]).epsilon(std::is_same<T, float>::value ? 1e-4 : 1e-10));
+			}
+		}
+
+		kernels::setIsa(active);
+	}
+}
+
+TEST_CASE_TEMPLATE("kernels match scalar reference", T, doctest::Types<float, double>)
+{
+	const auto random = [](std::size_t size) { return util::randomVector<T>(size, util::randomNormal); };
+
+	// odd sizes exercise the remainder paths and partial gemm tiles
+	const std::size_t rows = 37, cols = 301, ld = 305;
+	const auto A = random(rows * ld);
+	const auto x = random(cols);
+	const auto y = random(rows);
+
+	SUBCASE("gemv")
+	{
+		compareWithScalar<T>([&]
+		{
+			auto out = y;
+			kernels::gemv(rows, cols, A.data(), ld, x.data(), out.data());
+			return out;
+		});
+	}
+	SUBCASE("gemvT")
+	{
+		compareWithScalar<T>([&]
+		{
+			auto out = x;
+			kernels::gemvT(rows, cols, A.data(), ld, y.data(), out.data());
+			return out;
+		});
+	}
+	SUBCASE("ger")
+	{
+		compareWithScalar<T>([&]
+		{
+			auto out = A;
+			kernels::ger(rows, cols, T(0.5), y.data(), x.data(), out.data(), ld);
+			return out;
+		});
+	}
+	SUBCASE("axpy")
+	{
+		compareWithScalar<T>([&]
+		{
+			auto out = x;
+			kernels::axpy(cols, T(-0.25), A.data(), out.data());
+			return out;
+		});
+	}
+	SUBCASE("activations")
+	{
+		for (auto function : { Activation::Identity, Activation::Sigmoid, Activation::Relu, Activation::LeakyRelu })
+		{
+			compareWithScalar<T>([&]
+			{
+				std::vector<T> out(cols);
+				activation::forward(function, cols, A.data(), out.data());
+				return out;
+			});
+			compareWithScalar<T>([&]
+			{
+				std::vector<T> out(2 * cols);
+				activation::forward(function, cols, A.data(), out.data(), out.data() + cols);
+				kernels::multiply(cols, x.data(), out.data());
+				return out;
+			});
+		}
+	}
+	SUBCASE("normalize bytes")
+	{
+		std::vector<std::uint8_t> bytes(cols);
+		for (std::size_t i {}; i < cols; i++)
+		{
+			bytes[i] = std::uint8_t(i * 7);
+		}
+		compareWithScalar<T>([&]
+		{
+			std::vector<T> out(cols);
+			kernels::normalizeBytes(cols, bytes.data(), T(255), out.data());
+			return out;
+		});
+	}
+	SUBCASE("sparse gemv")
+	{
+		// every third weight of A, and the blocks of A starting at every other
+		// multiple of the block width, x padded for the last block
+		constexpr std::size_t Block = kernels::SparseBlock<T>;
+		auto padded_x = x;
+		padded_x.resize((cols + Block - 1) / Block * Block);
+
+		std::vector<std::uint32_t> csr_offsets { 0 }, csr_columns, block_offsets { 0 }, block_columns;
+		std::vector<T> csr_values, block_values;
+		for (std::size_t r {}; r < rows; r++)
+		{
+			for (std::size_t c = r % 3; c < cols; c += 3)
+			{
+				csr_columns.push_back(std::uint32_t(c));
+				csr_values.push_back(A[r * ld + c]);
+			}
+			csr_offsets.push_back(std::uint32_t(csr_columns.size()));
+			for (std::size_t c = r % 2 * Block; c < cols; c += 2 * Block)
+			{
+				block_columns.push_back(std::uint32_t(c));
+				for (std::size_t j {}; j < Block; j++)
+				{
+					block_values.push_back(c + j < cols ? A[r * ld + c + j] : T{});
+				}
+			}
+			block_offsets.push_back(std::uint32_t(block_columns.size()));
+		}
+
+		compareWithScalar<T>([&]
+		{
+			auto out = y;
+			kernels::csrGemv(rows, csr_offsets.data(), csr_columns.data(), csr_values.data(), x.data(), out.data());
+			kernels::blockedGemv(rows, block_offsets.data(), block_columns.data(), block_values.data(), padded_x.data(), out.data());
+			return out;
+		});
+	}
+	SUBCASE("gemm")
+	{
+		const std::size_t m = 103, n = 45, k = 290;
+		const auto a = random(m * k);
+		const auto B = random(k * n);
+		const auto C = random(m * n);
+		for (auto transA : { kernels::Transpose::No, kernels::Transpose::Yes })
+		{
+			for (auto transB : { kernels::Transpose::No, kernels::Transpose::Yes })
+			{
+				compareWithScalar<T>([&]
+				{
+					auto out = C;
+					kernels::gemm(transA, transB, m, n, k,
+								  a.data(), transA == kernels::Transpose::No ? k : m,
+								  B.data(), transB == kernels::Transpose::No ? n : k,
+								  out.data(), n);
+					return out;
+				});
+			}
+		}
+	}
+}
+
+TEST_CASE("integer gemv is exact on every instruction set")
+{
+	const std::size_t rows = 13, cols = 203, ld = 256;
+	std::vector<std::int8_t> A(rows * ld);
+	std::vector<std::uint8_t> x(cols);
+	for (std::size_t i {}; i < A.size(); i++)
+	{
+		A[i] = static_cast<std::int8_t>(int(i * 7919 % 255) - 127);
+	}
+	for (std::size_t c {}; c < cols; c++)
+	{
+		x[c] = static_cast<std::uint8_t>(c * 31 % 128);
+	}
+	// the extremes, where 16-bit pair sums would be closest to saturating
+	std::fill(A.begin(), A.begin() + cols, std::int8_t(-127));
+	std::fill(x.begin(), x.begin() + 64, std::uint8_t(127));
+
+	std::vector<std::int32_t> expected(rows, 5);
+	for (std::size_t r {}; r < rows; r++)
+	{
+		for (std::size_t c {}; c < cols; c++)
+		{
+			expected[r] += A[r * ld + c] * x[c];
+		}
+	}
+
+	const auto active = kernels::activeIsa();
+	for (auto isa : { kernels::Isa::Scalar, kernels::Isa::Sse2, kernels::Isa::Avx2, kernels::Isa::Avx512 })
+	{
+		if (!kernels::isSupported(isa))
+		{
+			continue;
+		}
+		kernels::setIsa(isa);
+		const std::string name = std::string(kernels::isaName(isa)) + (kernels::usesVnni() ? " vnni" : "");
+		INFO(name);
+
+		std::vector<std::int32_t> y(rows, 5);
+		kernels::gemvU8S8(rows, cols, A.data(), ld, x.data(), y.data());
+		CHECK(y == expected);
+	}
+	kernels::setIsa(active);
+}
+
+TEST_CASE("thread pool")
+{
+	ThreadPool pool(4, true);
+	CHECK(pool.concurrency() == 4);
+
+	SUBCASE("parallel for visits every index once in grain sized pieces")
+	{
+		std::vector<std::atomic<int>> visits(1000);
+		std::atomic<bool> too_long {};
+		parallel_for(3, visits.size(), 7, [&](std::size_t first, std::size_t last)
+		{
+			too_long = too_long || last - first > 7;
+			for (std::size_t i = first; i < last; i++)
+			{
+				visits[i]++;
+			}
+		}, pool);
+
+		CHECK(!too_long);
+		CHECK(std::count(visits.begin(), visits.begin() + 3, 0) == 3);
+		CHECK(std::count(visits.begin() + 3, visits.end(), 1) == int(visits.size() - 3));
+	}
+	SUBCASE("nested parallel for")
+	{
+		std::atomic<int> sum {};
+		parallel_for(0, 16, 1, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i = first; i < last; i++)
+			{
+				parallel_for(0, 100, 10, [&](std::size_t inner_first, std::size_t inner_last) { sum += int(inner_last - inner_first); }, pool);
+			}
+		}, pool);
+		CHECK(sum == 1600);
+	}
+	SUBCASE("exceptions reach the waiting thread")
+	{
+		CHECK_THROWS_AS(parallel_for(0, 100, 1, [](std::size_t first, std::size_t) {
+			if (first == 57)
+			{
+				throw std::runtime_error("task failed");
+			}
+		}, pool), std::runtime_error);
+	}
+}
+
 TEST_CASE("sigmoid")
 {
 	CHECK(util::sigmoid(-5.) < 0.1);
@@ -45,18 +441,56 @@ TEST_CASE("sigmoid")
 
 }
 
+TEST_CASE_TEMPLATE("activation kernels match util functions", T, doctest::Types<float, double>)
+{
+	const auto tolerance = std::is_same<T, float>::value ? 1e-6 : 1e-12;
+
+	std::vector<T> z;
+	for (int i = -400; i <= 400; i++)
+	{
+		z.push_back(T(i) / 20);
+	}
+
+	const auto check = [&](Activation function, double (*forward)(double), double (*derivative)(double))
+	{
+		std::vector<T> a(z.size());
+		std::vector<T> e(z.size(), T(2));
+		std::vector<T> fused_a(z.size());
+		std::vector<T> fused_d(z.size());
+		activation::forward(function, z.size(), z.data(), a.data());
+		activation::forward(function, z.size(), z.data(), fused_a.data(), fused_d.data());
+		// errors times the cached derivatives, as training applies them
+		kernels::multiply(z.size(), fused_d.data(), e.data());
+
+		const std::string name = activation::name(function);
+		INFO(name);
+		for (std::size_t i {}; i < z.size(); i++)
+		{
+			CHECK(a[i] == doctest::Approx(forward(z[i])).epsilon(tolerance));
+			CHECK(e[i] == doctest::Approx(2 * derivative(z[i])).epsilon(tolerance));
+			CHECK(fused_a[i] == a[i]);
+			CHECK(fused_d[i] == doctest::Approx(derivative(z[i])).epsilon(tolerance));
+		}
+	};
+
+	check(Activation::Identity, &util::identity, &util::identityPrime);
+	check(Activation::Sigmoid, &util::sigmoid, &util::sigmoidPrime);
+	check(Activation::Relu, &util::relu, &util::reluPrime);
+	check(Activation::LeakyRelu, &util::leakyRelu, &util::leakyReluPrime);
+}
+
 TEST_CASE("basic feed forward")
 {
 	Network n({2, 2, 1});
-	n.layers[1].neurons[0].weights[0] = 0.5;
-	n.layers[1].neurons[0].weights[1] = 0.5;
-	n.layers[1].neurons[0].bias = -1;
-	n.layers[1].neurons[1].weights[0] = 0.5;
-	n.layers[1].neurons[1].weights[1] = 0.5;
-	n.layers[1].neurons[1].bias = 0.0;
-	n.layers[2].neurons[0].weights[0] = 0.5;
-	n.layers[2].neurons[0].weights[1] = 0.5;
-	n.layers[2].neurons[0].bias = -0.5;
+	n.layers[1].neuron(0).weights[0] = 0.5;
+	n.layers[1].neuron(0).weights[1] = 0.5;
+	n.layers[1].neuron(0).bias = -1;
+	n.layers[1].neuron(1).weights[0] = 0.5;
+	n.layers[1].neuron(1).weights[1] = 0.5;
+	n.layers[1].neuron(1).bias = 0.0;
+	n.layers[2].neuron(0).weights[0] = 0.5;
+	n.layers[2].neuron(0).weights[1] = 0.5;
+	n.layers[2].neuron(0).bias = -0.5;
 
 	auto result = n.feedForward({1.0, 1.0});
 	CHECK(result[0] == 0);
@@ -79,7 +513,977 @@ TEST_CASE("learn only one sample")
 	CHECK(result[1] > 0.8);
 }
 
+TEST_CASE("learn batch matches accumulated learn once")
+{
+	Network once({4, 3, 2}, Activation::Sigmoid, 0.5, 3);
+	Network batch = once;
+
+	std::vector<std::vector<double>> in { { 0, 1, 0, 1 }, { 1, 0, 0, 0 }, { 0.5, 0.5, 1, 0 } };
+	std::vector<std::vector<double>> out { { 1, 0 }, { 0, 1 }, { 1, 1 } };
+
+	for (std::size_t s {}; s < in.size(); s++)
+	{
+		once.learnOnce(in[s], out[s]);
+	}
+	batch.learnBatch(in, out);
+
+	for (std::size_t layer = 1; layer < once.layers.size(); layer++)
+	{
+		for (std::size_t i {}; i < once.layers[layer].weights.size(); i++)
+		{
+			CHECK(batch.layers[layer].weights[i] == doctest::Approx(once.layers[layer].weights[i]));
+		}
+		for (std::size_t i {}; i < once.layers[layer].biases.size(); i++)
+		{
+			CHECK(batch.layers[layer].biases[i] == doctest::Approx(once.layers[layer].biases[i]));
+		}
+	}
+
+	const util::span<const std::vector<double>> targets(out);
+	CHECK_THROWS_AS(batch.learnBatch(in, targets.subspan(0, 2)), std::invalid_argument);
+	const std::vector<int> labels { 0, 1 };
+	CHECK_THROWS_AS(batch.learnBatch(in, labels), std::invalid_argument);
+	Network<double>::BatchWorkspace workspace;
+	auto updates = batch.makeCorrections();
+	CHECK_THROWS_AS(batch.accumulateGradients(in, { {}, labels }, workspace, updates.layers), std::invalid_argument);
+}
+
+TEST_CASE("derivatives are only cached while training")
+{
+	Network n({4, 3, 2}, Activation::Sigmoid);
+	n.feedForward({ 0, 1, 0, 1 });
+	for (std::size_t i {}; i < 3; i++)
+	{
+		CHECK(n.layers[1].derivatives[i] == 0);
+	}
+
+	n.learnOnce({ 0, 1, 0, 1 }, { 1, 0 });
+	REQUIRE(n.layers[1].derivatives.size() == 3);
+	for (std::size_t i {}; i < 3; i++)
+	{
+		CHECK(n.layers[1].derivatives[i] == doctest::Approx(util::sigmoidPrime(n.layers[1].z[i])));
+	}
+}
+
+TEST_CASE("built-in activation learns like custom callbacks")
+{
+	Network custom({4, 3, 2}, &util::leakyRelu, &util::leakyReluPrime, 0.1);
+	Network builtin({4, 3, 2}, Activation::LeakyRelu, 0.1);
+	std::copy(custom.parameters().begin(), custom.parameters().end(), builtin.parameters().begin());
+
+	for (int epoch {}; epoch < 20; epoch++)
+	{
+		custom.learnOnce({ 0, 1, -1, 1 }, { 1, 0 });
+		builtin.learnOnce({ 0, 1, -1, 1 }, { 1, 0 });
+	}
+
+	const auto expected = custom.feedForward({ 0, 1, -1, 1 });
+	const auto result = builtin.feedForward({ 0, 1, -1, 1 });
+	CHECK(result[0] == doctest::Approx(expected[0]));
+	CHECK(result[1] == doctest::Approx(expected[1]));
+}
+
+TEST_CASE("model predicts like the network it was taken from")
+{
+	for (auto function : { Activation::Sigmoid, Activation::Custom })
+	{
+		auto n = function == Activation::Custom
+			? Network({5, 7, 3}, &util::sigmoid, &util::sigmoidPrime)
+			: Network({5, 7, 3}, function);
+		const Model model(n);
+		CHECK(model.architecture() == n.architecture());
+
+		InferenceContext context(model);
+		const std::vector<double> in { 0.5, -1, 0, 2, 1 };
+		const auto expected = n.feedForward(in);
+		const auto result = model.predict(in, context);
+		REQUIRE(result.size() == expected.size());
+		for (std::size_t i {}; i < expected.size(); i++)
+		{
+			CHECK(result[i] == expected[i]);
+		}
+	}
+}
+
+TEST_CASE("quantized model stays close to the float model")
+{
+	Network n({20, 16, 4}, Activation::LeakyRelu);
+	const Model model(n);
+
+	std::vector<std::vector<double>> inputs;
+	std::vector<int> labels;
+	for (int i {}; i < 300; i++)
+	{
+		inputs.push_back(util::randomVector<double>(20, [] { return std::abs(util::randomNormal()) / 3; }));
+		labels.push_back(i % 4);
+	}
+	const QuantizedModel quantized(model, inputs);
+	CHECK(quantized.architecture() == model.architecture());
+
+	InferenceContext<double> context;
+	QuantizedContext quantized_context;
+	double largest {}, error {};
+	std::size_t agreements {};
+	for (const auto& input : inputs)
+	{
+		const auto expected = model.predict(input, context);
+		const auto result = quantized.predict(util::span<const double>(input), quantized_context);
+		for (std::size_t i {}; i < expected.size(); i++)
+		{
+			largest = std::max(largest, std::abs(expected[i]));
+			error = std::max(error, std::abs(expected[i] - result[i]));
+		}
+		agreements += quantized.classify(util::span<const double>(input), quantized_context) == util::argmax(expected);
+	}
+	CHECK(error < 0.03 * largest);
+	CHECK(agreements > 0.9 * inputs.size());
+
+	const auto evaluation = evaluate<double>(quantized, inputs, labels, 32);
+	std::size_t correct {};
+	for (std::size_t i {}; i < inputs.size(); i++)
+	{
+		correct += quantized.classify(util::span<const double>(inputs[i]), quantized_context) == labels[i];
+	}
+	CHECK(evaluation.correct == correct);
+}
+
+TEST_CASE("pruned weights stay pruned and sparse models predict the same")
+{
+	Network n({40, 16, 4}, Activation::LeakyRelu, 0.1, 4);
+	std::vector<std::vector<double>> inputs;
+	std::vector<int> labels;
+	for (int i {}; i < 64; i++)
+	{
+		inputs.push_back(util::randomVector<double>(40, util::randomNormal));
+		labels.push_back(i % 4);
+	}
+
+	for (std::size_t group : { std::size_t(1), kernels::SparseBlock<double> })
+	{
+		auto pruned = n;
+		const PruningMask<double> mask(pruned, 0.75, group);
+		CHECK(mask.sparsity() == doctest::Approx(0.75).epsilon(0.02));
+
+		fineTune(pruned, mask, inputs, labels, 2, 2);
+		std::size_t zeros {}, weights {};
+		for (std::size_t layer = 1; layer < pruned.layers.size(); layer++)
+		{
+			const auto& layer_weights = pruned.layers[layer].weights;
+			zeros += std::count(layer_weights.begin(), layer_weights.end(), 0.);
+			weights += layer_weights.size();
+		}
+		CHECK(double(zeros) / weights >= mask.sparsity());
+
+		const Model model(pruned);
+		InferenceContext<double> context, sparse_context;
+		for (auto format : { SparseModel<double>::Format::Csr, SparseModel<double>::Format::Blocked })
+		{
+			const SparseModel<double> sparse(model, format);
+			CHECK(sparse.architecture() == model.architecture());
+			CHECK(sparse.storedWeights() < weights);
+			for (const auto& input : inputs)
+			{
+				const auto expected = model.predict(input, context);
+				const auto result = sparse.predict(input, sparse_context);
+				REQUIRE(result.size() == expected.size());
+				for (std::size_t i {}; i < expected.size(); i++)
+				{
+					CHECK(result[i] == doctest::Approx(expected[i]));
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("pruned networks fine-tune and evaluate on dataset views")
+{
+	std::vector<std::uint8_t> bytes(64 * 40);
+	std::vector<int> labels;
+	for (std::size_t i {}; i < bytes.size(); i++)
+	{
+		bytes[i] = std::uint8_t(i * 37 % 256);
+	}
+	for (int i {}; i < 64; i++)
+	{
+		labels.push_back(i % 4);
+	}
+	const DatasetView view(Dataset(40, bytes, labels));
+	std::vector<std::vector<double>> inputs;
+	view.assemble(0, view.size(), inputs);
+
+	Network n({40, 16, 4}, Activation::LeakyRelu, 0.1, 4);
+	const PruningMask<double> mask(n, 0.5);
+	auto from_vectors = n, from_view = n;
+	fineTune(from_vectors, mask, inputs, labels, 2, 2);
+	fineTune(from_view, mask, view, 2, 2);
+	CHECK(std::equal(from_vectors.parameters().begin(), from_vectors.parameters().end(), from_view.parameters().begin()));
+
+	const SparseModel<double> sparse(Model<double>(from_view), SparseModel<double>::Format::Csr);
+	const auto expected = evaluate(sparse, inputs, labels, 16);
+	const auto result = evaluate(sparse, view, 16);
+	CHECK(result.correct == expected.correct);
+	CHECK(result.confusion == expected.confusion);
+}
+
+TEST_CASE("saved model loads and predicts the same")
+{
+	const std::string path = "model_test.bin";
+	Network<float> n({5, 7, 3}, Activation::LeakyRelu);
+	const Model<float> model(n);
+	model.save(path);
+
+	{
+		const auto loaded = Model<float>::load(path);
+		CHECK(loaded.architecture() == model.architecture());
+		CHECK(loaded.activation() == Activation::LeakyRelu);
+		CHECK(reinterpret_cast<std::uintptr_t>(loaded.layers()[1].weights.data()) % util::CacheLineSize == 0);
+
+		const auto copy = loaded;
+		CHECK(copy.layers()[1].weights.data() == loaded.layers()[1].weights.data());
+
+		InferenceContext<float> context;
+		const std::vector<float> in { 0.5f, -1, 0, 2, 1 };
+		const auto expected = n.feedForward(in);
+		const auto result = copy.predict(in, context);
+		for (std::size_t i {}; i < expected.size(); i++)
+		{
+			CHECK(result[i] == expected[i]);
+		}
+
+		CHECK_THROWS_AS(Model<double>::load(path), std::runtime_error);
+		CHECK_THROWS_AS(Model<float>::load("main_test.cpp"), std::runtime_error);
+		CHECK_THROWS_AS(Model(Network({2, 2}, &util::sigmoid, &util::sigmoidPrime)).save(path), std::runtime_error);
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("damaged model files don't load")
+{
+	const std::string path = "model_damaged_test.bin";
+	Model<float>(Network<float>({4, 16}, Activation::Relu)).save(path);
+	std::string contents;
+	{
+		std::ifstream file(path, std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	// the header fields after magic, version, byte order, scalar size and activation
+	const auto load_with = [&](std::size_t offset, std::uint64_t value)
+	{
+		auto damaged = contents;
+		std::memcpy(&damaged[offset], &value, sizeof(value));
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+		return Model<float>::load(path);
+	};
+	const std::size_t layer_count = 24, parameter_count = 40, first_size = 48;
+
+	CHECK_NOTHROW(load_with(layer_count, 2));
+	// layerCount * 8 wraps to 16
+	CHECK_THROWS_AS(load_with(layer_count, (std::uint64_t(1) << 61) + 2), std::runtime_error);
+	CHECK_THROWS_AS(load_with(parameter_count, std::uint64_t(-1)), std::runtime_error);
+	// 2^62 + 16 floats take 64 bytes after wrapping, and 2^58 inputs times 16
+	// outputs plus 16 biases add up to exactly that count
+	{
+		auto damaged = contents;
+		const std::uint64_t count = (std::uint64_t(1) << 62) + 16, inputs = std::uint64_t(1) << 58;
+		std::memcpy(&damaged[parameter_count], &count, sizeof(count));
+		std::memcpy(&damaged[first_size], &inputs, sizeof(inputs));
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+		CHECK_THROWS_AS(Model<float>::load(path), std::runtime_error);
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("exported header holds the exact parameters")
+{
+	Network<float> n({5, 7, 3}, Activation::LeakyRelu);
+	const Model<float> model(n);
+	std::ostringstream out;
+	exportHeader(model, out, "exported");
+	const std::string header = out.str();
+
+	CHECK(header.find("namespace exported") != std::string::npos);
+	CHECK(header.find("constexpr std::size_t Inputs = 5;") != std::string::npos);
+	CHECK(header.find("constexpr std::size_t Outputs = 3;") != std::string::npos);
+	CHECK(header.find("x < 0 ? ") != std::string::npos);
+	CHECK(header.find("#include \"") == std::string::npos);
+
+	// weights1 holds the second layer in panels of a cache line of rows
+	const std::size_t begin = header.find('{', header.find("weights1[")) + 1;
+	std::istringstream values(header.substr(begin, header.find('}', begin) - begin));
+	std::vector<float> parsed;
+	for (std::string value; std::getline(values >> std::ws, value, ',');)
+	{
+		parsed.push_back(std::strtof(value.c_str(), nullptr));
+	}
+	const auto& layer = model.layers()[1];
+	const std::size_t block = util::CacheLineSize / sizeof(float);
+	REQUIRE(parsed.size() == (layer.size + block - 1) / block * block * layer.previousSize);
+	for (std::size_t i {}; i < parsed.size(); i++)
+	{
+		const std::size_t first = i / (block * layer.previousSize) * block;
+		const std::size_t column = i / block % layer.previousSize;
+		const std::size_t row = first + i % block;
+		CHECK(parsed[i] == (row < layer.size ? layer.weights[row * layer.previousSize + column] : 0.f));
+	}
+
+	CHECK_THROWS_AS(exportHeader(model, out, "not a name"), std::invalid_argument);
+	CHECK_THROWS_AS(exportHeader(Model(Network({2, 2}, &util::sigmoid, &util::sigmoidPrime)), out, "custom"), std::runtime_error);
+}
+
+TEST_CASE("exported header predicts like the model")
+{
+	Network<float> n({6, 5, 3}, Activation::LeakyRelu);
+	auto parameters = n.parameters();
+	for (std::size_t i {}; i < parameters.size(); i++)
+	{
+		// exact in hexadecimal, so the text doesn't depend on the math library
+		parameters[i] = float(int(i * 37 % 101) - 50) / 64;
+	}
+	const Model<float> model(n);
+
+	// the fixture is still what exportHeader writes, regenerate it otherwise
+	std::ostringstream out;
+	exportHeader(model, out, "model_export_fixture");
+	// next to this file, wherever the tests run
+	const std::string source = __FILE__;
+	std::ifstream fixture(source.substr(0, source.find_last_of("/\\") + 1) + "model_export_fixture.h");
+	REQUIRE(fixture);
+	CHECK(out.str() == std::string(std::istreambuf_iterator<char>(fixture), std::istreambuf_iterator<char>()));
+
+	InferenceContext<float> context;
+	for (int sample {}; sample < 16; sample++)
+	{
+		const auto input = util::randomVector<float>(6, util::randomNormal);
+		const auto expected = model.predict(input, context);
+		const auto result = model_export_fixture::predict(input.data());
+		REQUIRE(expected.size() == result.size());
+		for (std::size_t i {}; i < result.size(); i++)
+		{
+			CHECK(result[i] == doctest::Approx(expected[i]));
+		}
+		CHECK(model_export_fixture::classify(input.data()) == util::argmax(expected));
+	}
+}
+
+TEST_CASE("checkpoints resume the latest snapshot")
+{
+	const std::string path = "checkpoint_test.bin";
+	const auto file_size = [&] { return std::size_t(std::ifstream(path, std::ios::binary | std::ios::ate).tellg()); };
+
+	Network n({6, 8, 3}, Activation::Sigmoid, 0.5);
+	std::vector<double> saved;
+	{
+		Checkpointer<double> checkpointer(path, 2);
+		for (int epoch = 1; epoch <= 5; epoch++)
+		{
+			n.learnOnce({ 0, 1, 0, 1, 1, 0 }, epoch % 3);
+			if (checkpointer.update(n, epoch))
+			{
+				saved.assign(n.parameters().begin(), n.parameters().end());
+			}
+		}
+		checkpointer.save(n, 5);
+		checkpointer.wait();
+		const auto size = file_size();
+
+		// unchanged parameters make an all-zero delta
+		checkpointer.save(n, 6);
+		checkpointer.wait();
+		CHECK(file_size() - size < 64);
+		saved.assign(n.parameters().begin(), n.parameters().end());
+	}
+
+	Network restored({6, 8, 3}, Activation::Sigmoid);
+	CHECK(Checkpointer<double>::resume(path, restored) == 6);
+	CHECK(std::equal(saved.begin(), saved.end(), restored.parameters().begin()));
+
+	SUBCASE("damaged tail")
+	{
+		std::ofstream(path, std::ios::binary | std::ios::app) << "CKPT and then the crash";
+		CHECK(Checkpointer<double>::resume(path, restored) == 6);
+	}
+
+	SUBCASE("other networks")
+	{
+		Network other({6, 9, 3});
+		CHECK_THROWS_AS(Checkpointer<double>::resume(path, other), std::runtime_error);
+		CHECK(Checkpointer<double>::resume("missing_checkpoint.bin", other) == 0);
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("checkpoints report failed writes")
+{
+	Network n({6, 8, 3}, Activation::Sigmoid, 0.5);
+	Checkpointer<double> checkpointer("missing_directory/checkpoint.bin");
+	checkpointer.save(n, 1);
+	CHECK_THROWS_AS(checkpointer.wait(), std::runtime_error);
+
+	// without waiting, the failure comes out of a later snapshot
+	const auto update_until_failed = [&]
+	{
+		for (int epoch = 2; epoch < 1000; epoch++)
+		{
+			checkpointer.update(n, epoch);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	};
+	CHECK_THROWS_AS(update_until_failed(), std::runtime_error);
+}
+
+TEST_CASE("batched evaluation matches one by one classification")
+{
+	Network n({8, 12, 4}, Activation::Sigmoid);
+	const Model model(n);
+
+	std::vector<std::vector<double>> inputs;
+	std::vector<int> labels;
+	for (int i {}; i < 1000; i++)
+	{
+		inputs.push_back(util::randomVector<double>(8, [] { return 100 * util::randomNormal(); }));
+		labels.push_back(i % 4);
+	}
+
+	InferenceContext<double> context;
+	const auto batch = model.predictBatch(util::span<const std::vector<double>>(inputs).subspan(0, 7), context);
+	const auto batch_outputs = std::vector<double>(batch.begin(), batch.end());
+	for (std::size_t s {}; s < 7; s++)
+	{
+		const auto single = model.predict(inputs[s], context);
+		for (std::size_t i {}; i < 4; i++)
+		{
+			CHECK(batch_outputs[s * 4 + i] == doctest::Approx(single[i]));
+		}
+	}
+
+	std::vector<std::size_t> confusion(16);
+	for (std::size_t s {}; s < inputs.size(); s++)
+	{
+		confusion[labels[s] * 4 + util::argmax(n.feedForward(inputs[s]))]++;
+	}
+
+	const auto evaluation = evaluate(model, inputs, labels, 64);
+	CHECK(evaluation.total == inputs.size());
+	CHECK(evaluation.confusion == confusion);
+	CHECK(evaluation.correct == confusion[0] + confusion[5] + confusion[10] + confusion[15]);
+
+	const util::span<const std::vector<double>> all(inputs);
+	CHECK_THROWS_AS(evaluate(model, all.subspan(0, 10), labels), std::invalid_argument);
+	auto wrong_labels = labels;
+	wrong_labels[3] = 4;
+	CHECK_THROWS_AS(evaluate(model, inputs, wrong_labels), std::invalid_argument);
+	wrong_labels[3] = -1;
+	CHECK_THROWS_AS(evaluate(model, inputs, wrong_labels), std::invalid_argument);
+}
+
+TEST_CASE("model is shared by concurrent predictions")
+{
+	Network n({20, 30, 10}, Activation::LeakyRelu);
+	const Model model(n);
+
+	std::vector<std::vector<double>> inputs;
+	std::vector<std::vector<double>> expected;
+	for (int i {}; i < 64; i++)
+	{
+		inputs.push_back(util::randomNormalVector(20));
+		expected.push_back(n.feedForward(inputs.back()));
+	}
+
+	std::vector<int> mismatches(4);
+	std::vector<std::thread> threads;
+	for (std::size_t t {}; t < mismatches.size(); t++)
+	{
+		threads.emplace_back([&, t]
+		{
+			InferenceContext<double> context;
+			for (int repeat {}; repeat < 50; repeat++)
+			{
+				for (std::size_t i {}; i < inputs.size(); i++)
+				{
+					const auto result = model.predict(inputs[i], context);
+					mismatches[t] += !std::equal(result.begin(), result.end(), expected[i].begin());
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	for (auto count : mismatches)
+	{
+		CHECK(count == 0);
+	}
+}
+
+TEST_CASE("parallel trainer matches learn batch")
+{
+	Network reference({6, 5, 3}, Activation::Sigmoid, 0.5);
+
+	std::vector<std::vector<double>> in;
+	std::vector<std::vector<double>> out;
+	for (int s {}; s < 11; s++)
+	{
+		in.push_back(util::randomNormalVector(6));
+		out.push_back({ s % 2 ? 1. : 0., s % 3 ? 1. : 0., 0.5 });
+	}
+
+	for (std::size_t threads : { 1, 3, 4, 16 })
+	{
+		auto n = reference;
+		auto expected = reference;
+		{
+			ParallelTrainer<double> trainer(n, threads);
+			CHECK(trainer.threadCount() == threads);
+			for (int epoch {}; epoch < 3; epoch++)
+			{
+				trainer.learnBatch(in, out);
+				expected.learnBatch(in, out);
+			}
+		}
+
+		for (std::size_t layer = 1; layer < n.layers.size(); layer++)
+		{
+			for (std::size_t i {}; i < n.layers[layer].weights.size(); i++)
+			{
+				CHECK(n.layers[layer].weights[i] == doctest::Approx(expected.layers[layer].weights[i]));
+			}
+			for (std::size_t i {}; i < n.layers[layer].biases.size(); i++)
+			{
+				CHECK(n.layers[layer].biases[i] == doctest::Approx(expected.layers[layer].biases[i]));
+			}
+		}
+	}
+
+	auto n = reference;
+	const util::span<const std::vector<double>> targets(out);
+	for (auto mode : { TrainingMode::Synchronous, TrainingMode::Hogwild })
+	{
+		ParallelTrainer<double> trainer(n, 2, mode);
+		CHECK_THROWS_AS(trainer.learnEpoch(in, targets.subspan(0, 10)), std::invalid_argument);
+		CHECK_THROWS_AS(trainer.learnBatch(in, targets.subspan(0, 10)), std::invalid_argument);
+	}
+}
+
+TEST_CASE("unsynchronized learn once matches learn once")
+{
+	Network once({4, 3, 2}, Activation::Sigmoid, 0.5);
+	Network unsynchronized = once;
+	Network<double>::BatchWorkspace workspace;
+
+	once.learnOnce({ 0, 1, 0, 1 }, { 1, 0 });
+	const std::vector<std::vector<double>> expected { { 1, 0 } };
+	unsynchronized.learnOnceUnsynchronized({ 0, 1, 0, 1 }, { expected, {} }, 0, workspace);
+
+	for (std::size_t layer = 1; layer < once.layers.size(); layer++)
+	{
+		for (std::size_t i {}; i < once.layers[layer].weights.size(); i++)
+		{
+			CHECK(unsynchronized.layers[layer].weights[i] == doctest::Approx(once.layers[layer].weights[i]));
+		}
+	}
+}
+
+TEST_CASE("hogwild trainer learns")
+{
+	Network n({4, 3, 2}, Activation::Sigmoid, 3.);
+	ParallelTrainer<double> trainer(n, 3, TrainingMode::Hogwild);
+
+	std::vector<std::vector<double>> in { { 0, 1, 0, 1 }, { 1, 0, 1, 0 } };
+	std::vector<std::vector<double>> out { { 1, 0 }, { 0, 1 } };
+	for (int epoch {}; epoch < 200; epoch++)
+	{
+		trainer.learnEpoch(in, out);
+	}
+
+	CHECK(util::argmax(n.feedForward(in[0])) == 0);
+	CHECK(util::argmax(n.feedForward(in[1])) == 1);
+}
+
+TEST_CASE("static network learns like the dynamic network")
+{
+	using Static = StaticNetwork<double, &util::sigmoid, &util::sigmoidPrime, 7, 6, 5, 3>;
+	static_assert(Static::LayerCount == 4 && Static::Inputs == 7 && Static::Outputs == 3, "layer sizes");
+
+	const std::vector<std::vector<double>> in { { 0.5, -1, 0, 2, 1, 0.25, -0.5 }, { 1, 0, -1, 0.5, 0, 1, 2 }, { 0, 0, 1, 1, 0, 0, 1 } };
+	const std::vector<std::vector<double>> out { { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } };
+	const std::vector<int> labels { 0, 2, 1 };
+
+	for (std::size_t batch_size : { 1, 2 })
+	{
+		Static s(0.5, batch_size);
+		Network n({7, 6, 5, 3}, &util::sigmoid, &util::sigmoidPrime, 0.5, batch_size);
+		const auto copy_layer = [&](auto& layer, std::size_t index)
+		{
+			for (std::size_t i {}; i < layer.Size; i++)
+			{
+				for (std::size_t j {}; j < layer.PreviousSize; j++)
+				{
+					layer.weight(i, j) = n.layers[index].weights[i * layer.PreviousSize + j];
+				}
+				layer.biases[i] = n.layers[index].biases[i];
+			}
+		};
+		copy_layer(s.layer<1>(), 1);
+		copy_layer(s.layer<2>(), 2);
+		copy_layer(s.layer<3>(), 3);
+
+		for (int epoch {}; epoch < 5; epoch++)
+		{
+			// learnOnce with an odd number of samples leaves a partial batch for learnBatch to finish
+			for (std::size_t i {}; i < in.size(); i++)
+			{
+				s.learnOnce(in[i], out[i]);
+				n.learnOnce(in[i], out[i]);
+			}
+			s.learnBatch(in, labels);
+			n.learnBatch(in, labels);
+		}
+
+		for (const auto& input : in)
+		{
+			const auto expected = n.feedForward(input);
+			const auto result = s.feedForward(input);
+			for (std::size_t i {}; i < expected.size(); i++)
+			{
+				CHECK(result[i] == doctest::Approx(expected[i]));
+			}
+		}
+
+		// copies own their layers
+		auto copy = s;
+		copy.learnOnce(in[0], labels[0]);
+		copy.learnOnce(in[1], labels[1]);
+		CHECK(copy.layer<3>().weight(0, 0) != s.layer<3>().weight(0, 0));
+	}
+}
+
+TEST_CASE("span inference does not allocate")
+{
+	Network n({6, 5, 3}, Activation::Sigmoid);
+	const Model model(n);
+	InferenceContext context(model);
+	StaticNetwork<double, &util::sigmoid, &util::sigmoidPrime, 6, 5, 3> s;
+
+	const std::vector<double> in { 0.5, -1, 0, 2, 1, 0.25 };
+	const auto expected = n.feedForward(in);
+	std::array<double, 3> out {};
+
+	const auto before = allocations.load();
+	n.feedForward(in, out);
+	const int network_class = n.classify(in);
+	const int model_class = model.classify(in, context);
+	s.feedForward(in, out);
+	const int static_class = s.classify(in);
+	const auto after = allocations.load();
+
+	CHECK(after == before);
+	n.feedForward(in);
+	CHECK(allocations.load() > after);
+
+	CHECK(network_class == util::argmax(expected));
+	CHECK(model_class == network_class);
+	CHECK(static_class == util::argmax(s.feedForward(in)));
+	CHECK(out[0] == s.feedForward(in)[0]);
+}
+
+TEST_CASE("training with labels does not allocate")
+{
+	const std::vector<std::vector<double>> inputs { { 0, 1, 0, 1 }, { 1, 0, 1, 0 }, { 1, 1, 0, 0 }, { 0, 0, 1, 1 }, { 1, 0, 0, 1 } };
+	const std::vector<int> labels { 0, 1, 2, 1, 0 };
+	std::vector<std::vector<double>> targets;
+	for (const int label : labels)
+	{
+		const auto target = util::vectorized<3>(label);
+		targets.emplace_back(target.begin(), target.end());
+	}
+
+	Network once({4, 5, 3}, Activation::Sigmoid, 0.5, 2);
+	Network batch = once;
+	Network synchronous = once;
+	Network hogwild = once;
+	Network one_hot = once;
+	ThreadPool pool(1);
+	ParallelTrainer<double> synchronous_trainer(synchronous, 1, TrainingMode::Synchronous, pool);
+	ParallelTrainer<double> hogwild_trainer(hogwild, 1, TrainingMode::Hogwild, pool);
+
+	const auto epoch = [&]
+	{
+		for (std::size_t i {}; i < inputs.size(); i++)
+		{
+			once.learnOnce(inputs[i], labels[i]);
+		}
+		for (std::size_t i {}; i < inputs.size(); i += 2)
+		{
+			const std::size_t count = std::min<std::size_t>(2, inputs.size() - i);
+			batch.learnBatch({ &inputs[i], count }, { &labels[i], count });
+		}
+		synchronous_trainer.learnEpoch(inputs, labels);
+		hogwild_trainer.learnEpoch(inputs, labels);
+	};
+
+	// the first epoch sizes every buffer
+	epoch();
+	const auto before = allocations.load();
+	for (int i {}; i < 3; i++)
+	{
+		epoch();
+	}
+	CHECK(allocations.load() == before);
+
+	for (int i {}; i < 4; i++)
+	{
+		for (std::size_t s {}; s < inputs.size(); s++)
+		{
+			one_hot.learnOnce(inputs[s], targets[s]);
+		}
+	}
+	for (std::size_t layer = 1; layer < once.layers.size(); layer++)
+	{
+		for (std::size_t i {}; i < once.layers[layer].weights.size(); i++)
+		{
+			CHECK(once.layers[layer].weights[i] == doctest::Approx(one_hot.layers[layer].weights[i]));
+			CHECK(synchronous.layers[layer].weights[i] == doctest::Approx(batch.layers[layer].weights[i]));
+		}
+	}
+}
+
+TEST_CASE("float network learns like double network")
+{
+	Network<double> d({4, 3, 2}, Activation::Sigmoid, 0.5);
+	Network<float> f({4, 3, 2}, Activation::Sigmoid, 0.5f);
+	for (std::size_t layer = 1; layer < d.layers.size(); layer++)
+	{
+		std::copy(d.layers[layer].weights.begin(), d.layers[layer].weights.end(), f.layers[layer].weights.begin());
+		std::copy(d.layers[layer].biases.begin(), d.layers[layer].biases.end(), f.layers[layer].biases.begin());
+	}
+
+	for (int epoch {}; epoch < 20; epoch++)
+	{
+		d.learnOnce({ 0, 1, 0, 1 }, { 1, 0 });
+		f.learnOnce({ 0, 1, 0, 1 }, { 1, 0 });
+	}
+
+	const auto expected = d.feedForward({ 0, 1, 0, 1 });
+	const auto result = f.feedForward({ 0, 1, 0, 1 });
+	CHECK(result[0] == doctest::Approx(expected[0]).epsilon(1e-4));
+	CHECK(result[1] == doctest::Approx(expected[1]).epsilon(1e-4));
+}
+
 #include <iostream>
+TEST_CASE("datasets store bytes and normalize batches")
+{
+	Dataset set(3, { 0, 51, 255, 102, 0, 17 }, { 4, 1 });
+	CHECK(set.size() == 2);
+	CHECK(set.sample(1)[0] == 102);
+	CHECK(set.label(1) == 1);
+
+	std::vector<std::vector<double>> batch { { 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 } };
+	set.assemble(0, 2, batch);
+	REQUIRE(batch.size() == 2);
+	CHECK(batch[0] == std::vector<double> { 0, 0.2, 1 });
+	CHECK(batch[1] == std::vector<double> { 0.4, 0, 17 / 255. });
+
+	const auto copy = set;
+	CHECK(copy.sample(0).data() == set.sample(0).data());
+
+	CHECK_THROWS_AS(Dataset(3, { 0, 1 }, { 4 }), std::invalid_argument);
+}
+
+TEST_CASE("dataset views select samples without copying")
+{
+	// sample i is 4 bytes of value i, labelled i % 3
+	std::vector<std::uint8_t> bytes;
+	std::vector<int> labels;
+	for (int i {}; i < 10; i++)
+	{
+		bytes.insert(bytes.end(), 4, std::uint8_t(i));
+		labels.push_back(i % 3);
+	}
+	const DatasetView all(Dataset(4, bytes, labels));
+	const auto indices = [](const DatasetView& view)
+	{
+		std::vector<std::size_t> result;
+		for (std::size_t i {}; i < view.size(); i++)
+		{
+			result.push_back(view.index(i));
+		}
+		return result;
+	};
+
+	const auto [learning, verification] = all.split(7);
+	CHECK(indices(learning) == std::vector<std::size_t> { 0, 1, 2, 3, 4, 5, 6 });
+	CHECK(indices(verification) == std::vector<std::size_t> { 7, 8, 9 });
+	CHECK(verification.sample(1).data() == all.sample(8).data());
+	CHECK(verification.label(2) == 0);
+
+	const auto subset = learning.range(2, 4).subset({ 3, 0 });
+	CHECK(indices(subset) == std::vector<std::size_t> { 5, 2 });
+
+	auto shuffled = indices(all.shuffled(1));
+	std::sort(shuffled.begin(), shuffled.end());
+	CHECK(shuffled == indices(all));
+
+	// every sample verifies in exactly one fold and trains in the others
+	std::vector<int> verified(all.size());
+	for (std::size_t fold {}; fold < 3; fold++)
+	{
+		const auto [training, verifying] = all.fold(3, fold);
+		CHECK(training.size() + verifying.size() == all.size());
+		for (const auto i : indices(verifying))
+		{
+			verified[i]++;
+			const auto trained = indices(training);
+			CHECK(std::find(trained.begin(), trained.end(), i) == trained.end());
+		}
+	}
+	CHECK(std::all_of(verified.begin(), verified.end(), [](int count) { return count == 1; }));
+	CHECK_THROWS_AS(all.fold(3, 3), std::out_of_range);
+
+	std::vector<std::vector<float>> batch;
+	std::vector<int> batch_labels;
+	subset.assemble(0, 2, batch, batch_labels);
+	CHECK(batch == std::vector<std::vector<float>> { std::vector<float>(4, 5 / 255.f), std::vector<float>(4, 2 / 255.f) });
+	CHECK(batch_labels == std::vector<int> { 2, 2 });
+
+	// a view evaluates like the normalized vectors
+	Network<float> n({4, 5, 3}, Activation::Sigmoid);
+	verification.assemble(0, verification.size(), batch, batch_labels);
+	const auto expected = evaluate(Model<float>(n), batch, batch_labels, 2);
+	const auto result = evaluate(Model<float>(n), verification, 2);
+	CHECK(result.correct == expected.correct);
+	CHECK(result.confusion == expected.confusion);
+}
+
+TEST_CASE("batch pipelines prefetch the batches of every epoch in order")
+{
+	// sample i is 2 bytes of value i, labelled i
+	std::vector<std::uint8_t> bytes;
+	std::vector<int> labels;
+	for (int i {}; i < 11; i++)
+	{
+		bytes.insert(bytes.end(), 2, std::uint8_t(i));
+		labels.push_back(i);
+	}
+	const DatasetView all(Dataset(2, bytes, labels));
+	const auto epoch_labels = [](BatchPipeline<float>& pipeline)
+	{
+		std::vector<int> result;
+		for (const auto& batch : pipeline.epoch())
+		{
+			CHECK(batch.inputs.size() == batch.labels.size());
+			result.insert(result.end(), batch.labels.begin(), batch.labels.end());
+		}
+		return result;
+	};
+
+	PipelineOptions<float> options;
+	options.producers = 2;
+	BatchPipeline<float> ordered(all, 4, options);
+	CHECK(ordered.batchesPerEpoch() == 3);
+	std::vector<std::vector<float>> expected;
+	for (int epoch {}; epoch < 2; epoch++)
+	{
+		std::size_t first {};
+		for (const auto& batch : ordered.epoch())
+		{
+			all.assemble(first, std::min<std::size_t>(4, all.size() - first), expected);
+			CHECK(batch.inputs == expected);
+			first += 4;
+		}
+		CHECK(first == 12);
+	}
+
+	// a new permutation every epoch, the same ones for the same seed
+	options.shuffle = true;
+	options.seed = 5;
+	BatchPipeline<float> shuffled(all, 3, options), again(all, 3, options);
+	const auto first_epoch = epoch_labels(shuffled);
+	const auto second_epoch = epoch_labels(shuffled);
+	CHECK(first_epoch != second_epoch);
+	CHECK(epoch_labels(again) == first_epoch);
+	auto sorted = second_epoch;
+	std::sort(sorted.begin(), sorted.end());
+	CHECK(sorted == labels);
+
+	// an epoch left early continues with the next one
+	for (const auto& batch : shuffled.epoch())
+	{
+		CHECK(batch.labels.size() == 3);
+		break;
+	}
+	epoch_labels(again);
+	epoch_labels(again);
+	const auto fourth_epoch = epoch_labels(again);
+	CHECK(epoch_labels(shuffled) == fourth_epoch);
+
+	options.augmentation = [](std::vector<float>& sample, std::mt19937&) { sample[0] = -1; };
+	options.depth = 1;
+	BatchPipeline<float> augmented(all, 11, options);
+	for (const auto& batch : augmented.epoch())
+	{
+		CHECK(std::all_of(batch.inputs.begin(), batch.inputs.end(), [](const auto& sample) { return sample[0] == -1 && sample[1] >= 0; }));
+	}
+
+	options.augmentation = [](std::vector<float>&, std::mt19937&) { throw std::runtime_error("augmentation"); };
+	BatchPipeline<float> failing(all, 4, options);
+	CHECK_THROWS_AS(epoch_labels(failing), std::runtime_error);
+}
+
+TEST_CASE("idx files are read with big-endian headers")
+{
+	// the directory is a prefix of the file names
+	const std::string prefix = "idx_test_";
+	const auto write = [](const std::string& path, std::vector<std::uint32_t> header, const std::vector<std::uint8_t>& data)
+	{
+		std::ofstream file(path, std::ios::binary);
+		for (const std::uint32_t value : header)
+		{
+			const char bytes[] { char(value >> 24), char(value >> 16), char(value >> 8), char(value) };
+			file.write(bytes, sizeof(bytes));
+		}
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	};
+
+	std::vector<std::uint8_t> pixels(3 * mnist::ImagePixelCount);
+	for (std::size_t i {}; i < pixels.size(); i++)
+	{
+		pixels[i] = std::uint8_t(i);
+	}
+	write(prefix + "t10k-labels.idx1-ubyte", { 0x801, 3 }, { 7, 0, 9 });
+	write(prefix + "t10k-images.idx3-ubyte", { 0x803, 3, 28, 28 }, pixels);
+
+	const auto data = mnist::readTestData<float>(prefix);
+	CHECK(data.labels == mnist::Labels { 7, 0, 9 });
+	REQUIRE(data.images.size() == 3);
+	CHECK(data.images[2][5] == pixels[2 * mnist::ImagePixelCount + 5] / 255.f);
+	CHECK(data.images[1][783] == pixels[2 * mnist::ImagePixelCount - 1] / 255.f);
+
+	// the raw pixels assemble into the same batches
+	const auto set = mnist::readTestSet(prefix);
+	REQUIRE(set.size() == 3);
+	CHECK(set.bytes() == 3 * (mnist::ImagePixelCount + sizeof(int)));
+	CHECK(set.labels()[2] == 9);
+	std::vector<std::vector<float>> batch;
+	set.assemble(1, 2, batch);
+	REQUIRE(batch.size() == 2);
+	CHECK(batch[0] == data.images[1]);
+	CHECK(batch[1] == data.images[2]);
+
+	// a truncated file gives no images
+	pixels.pop_back();
+	write(prefix + "t10k-images.idx3-ubyte", { 0x803, 3, 28, 28 }, pixels);
+	CHECK(mnist::readTestData<float>(prefix).images.empty());
+	CHECK(mnist::readTestSet(prefix).empty());
+
+	std::remove((prefix + "t10k-labels.idx1-ubyte").c_str());
+	std::remove((prefix + "t10k-images.idx3-ubyte").c_str());
+}
+
 TEST_CASE("images")
 {
 	Network n({784, 30, 10}, &util::leakyRelu, &util::leakyReluPrime, 0.003);
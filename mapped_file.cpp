@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util
+{
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path)
+{
+	const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Cannot open " + path);
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Cannot get the size of " + path);
+	}
+	length = std::size_t(size.QuadPart);
+
+	if (length > 0)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		address = mapping ? static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	}
+	CloseHandle(file);
+	if (length > 0 && !address)
+	{
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		throw std::runtime_error("Cannot map " + path);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (address)
+	{
+		UnmapViewOfFile(address);
+		CloseHandle(mapping);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		throw std::runtime_error("Cannot open " + path);
+	}
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		throw std::runtime_error("Cannot get the size of " + path);
+	}
+	length = std::size_t(status.st_size);
+
+	void* mapped = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0) : nullptr;
+	// the mapping keeps the file alive
+	close(file);
+	if (mapped == MAP_FAILED)
+	{
+		throw std::runtime_error("Cannot map " + path);
+	}
+	address = static_cast<const unsigned char*>(mapped);
+}
+
+MappedFile::~MappedFile()
+{
+	if (address)
+	{
+		munmap(const_cast<unsigned char*>(address), length);
+	}
+}
+
+#endif
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace util
+{
+
+// Read-only memory mapping of a whole file. The pages come from the page
+// cache, so every process mapping the same file shares one physical copy.
+class MappedFile
+{
+public:
+
+	explicit MappedFile(const std::string& path);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	const unsigned char* data() const { return address; }
+	std::size_t size() const { return length; }
+
+private:
+
+	const unsigned char* address {};
+	std::size_t length {};
+#if defined(_WIN32)
+	void* mapping {};
+#endif
+};
+
+}
@@ -1,5 +1,7 @@
 #include "mnist_custom_reader.h"
 
+#include "thread_pool.h"
+
 #include <QDir>
 #include <QImage>
 
@@ -7,9 +9,10 @@
 
 namespace
 {
-	std::pair<mnist::ImageData, bool> readSingleImage(const QString& path)
+	template <typename T>
+	std::pair<mnist::ImageData<T>, bool> readSingleImage(const QString& path)
 	{
-		mnist::ImageData pixels;
+		mnist::ImageData<T> pixels;
 
 		QImage image(path);
 		if (image.width() != mnist::ImageWidth || image.height() != mnist::ImageHeight)
@@ -17,12 +20,12 @@ namespace
 			return { pixels, false };
 		}
 
-		pixels.reserve(mnist::Data::Inputs);
+		pixels.reserve(mnist::Data<T>::Inputs);
 		for (int y = 0; y < image.height(); y++)
 		{
 			for (int x = 0; x < image.width(); x++)
 			{
-				pixels.push_back(qGray(image.pixel(x, y)) / 255.);
+				pixels.push_back(qGray(image.pixel(x, y)) / T(255));
 			}
 		}
 
@@ -33,18 +36,30 @@ namespace
 
 namespace mnist { namespace custom
 {
-	mnist::Data readImagesMatching(const std::string& dir, const std::string& pattern)
+	template <typename T>
+	mnist::Data<T> readImagesMatching(const std::string& dir, const std::string& pattern)
 	{
-		mnist::Data result;
+		mnist::Data<T> result;
+
+		const auto matches = QDir(QString::fromStdString(dir)).entryInfoList({ QString::fromStdString(pattern) });
 
-		auto matches = QDir(QString::fromStdString(dir)).entryInfoList({ QString::fromStdString(pattern) });
-		for (const auto& entry : matches)
+		// QImage is reentrant, the files are decoded on the pool
+		std::vector<std::pair<mnist::ImageData<T>, bool>> decoded(matches.size());
+		parallel_for(0, decoded.size(), 1, [&](std::size_t first, std::size_t last)
 		{
-			auto data = readSingleImage(entry.absoluteFilePath());
-			if (auto ok = data.second)
+			for (std::size_t i = first; i < last; i++)
+			{
+				decoded[i] = readSingleImage<T>(matches[int(i)].absoluteFilePath());
+			}
+		});
+
+		for (std::size_t i {}; i < decoded.size(); i++)
+		{
+			const auto& entry = matches[int(i)];
+			if (auto ok = decoded[i].second)
 			{
 				std::cout << "Image read: " << entry.absoluteFilePath().toStdString() << std::endl;;
-				result.images.push_back(data.first);
+				result.images.push_back(std::move(decoded[i].first));
 				result.labels.push_back(QFileInfo(entry).fileName().left(1).toInt());
 			}
 		}
@@ -53,4 +68,7 @@ namespace mnist { namespace custom
 		return result;
 	}
 
+	template mnist::Data<float> readImagesMatching<float>(const std::string& dir, const std::string& pattern);
+	template mnist::Data<double> readImagesMatching<double>(const std::string& dir, const std::string& pattern);
+
 } }
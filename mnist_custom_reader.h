@@ -4,5 +4,6 @@
 
 namespace mnist { namespace custom
 {
-	mnist::Data readImagesMatching(const std::string& dir, const std::string& pattern);
+	template <typename T = double>
+	mnist::Data<T> readImagesMatching(const std::string& dir, const std::string& pattern);
 } }
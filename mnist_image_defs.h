@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 namespace mnist
@@ -12,15 +13,18 @@ namespace mnist
 	using Label = int;
 	using Labels = std::vector<Label>;
 
-	using ImageData = std::vector<double>;
-	using ImagesData = std::vector<ImageData>;
+	template <typename T = double>
+	using ImageData = std::vector<T>;
+	template <typename T = double>
+	using ImagesData = std::vector<ImageData<T>>;
 
+	template <typename T = double>
 	struct Data
 	{
 		static const std::size_t Inputs = ImagePixelCount;
 		static const std::size_t Outputs = 10;
 
-		ImagesData images;
+		ImagesData<T> images;
 		Labels labels;
 	};
 
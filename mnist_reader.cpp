@@ -1,134 +1,155 @@
 #include "mnist_reader.h"
 
-#include <array>
-#include <fstream>
-#include <iostream>
-
-// hello MSVC
-#include <intrin.h>
+#include "kernels.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
 
-#pragma optimize( "", on )
+#include <cstdint>
+#include <iostream>
+#include <memory>
 
 namespace
 {
-	mnist::Labels labelsFromFile(const std::string& file)
+	constexpr std::uint32_t LabelsMagic = 0x00000801;
+	constexpr std::uint32_t ImagesMagic = 0x00000803;
+
+	// IDX header fields are big-endian whatever the host byte order
+	std::uint32_t readBigEndian(const unsigned char* p)
+	{
+		return std::uint32_t(p[0]) << 24 | std::uint32_t(p[1]) << 16 | std::uint32_t(p[2]) << 8 | std::uint32_t(p[3]);
+	}
+
+	std::shared_ptr<util::MappedFile> mapFile(const std::string& file)
 	{
-		mnist::Labels labels {};
-		std::ifstream labels_file(file, std::ios::binary);
-		if (!labels_file) {
+		try
+		{
+			return std::make_shared<util::MappedFile>(file);
+		}
+		catch (const std::exception&)
+		{
 			std::cerr << "no such file" << std::endl;
-			return labels;
+			return nullptr;
 		}
+	}
 
-		int magic {};
-		if (!labels_file.read(reinterpret_cast<char*>(&magic), sizeof(magic))) {
+	// Checks the magic number and the dimensions after the item count, returns
+	// the item count and points items at the data, or returns 0.
+	std::size_t readHeader(const util::MappedFile& file, std::uint32_t magic, std::initializer_list<std::uint32_t> dimensions,
+						   std::size_t item_size, const unsigned char*& items)
+	{
+		const std::size_t header_size = (2 + dimensions.size()) * sizeof(std::uint32_t);
+		if (file.size() < header_size)
+		{
 			std::cerr << "cannot read header" << std::endl;
-			return labels;
+			return 0;
 		}
-
-		magic = _byteswap_ulong(magic);
-
-		if (magic != 0x00000801) {
+		if (readBigEndian(file.data()) != magic)
+		{
 			std::cerr << "not a valid file" << std::endl;
-			return labels;
-		}
-
-		int count {};
-		if (!labels_file.read(reinterpret_cast<char*>(&count), sizeof(count))) {
-			std::cerr << "cannot read size" << std::endl;
-			return labels;
+			return 0;
 		}
 
-		count = _byteswap_ulong(count);
-
-		for (int i {}; i < count; i++)
+		const std::size_t count = readBigEndian(file.data() + 4);
+		const unsigned char* dimension = file.data() + 8;
+		for (const std::uint32_t expected : dimensions)
 		{
-			char label {};
-			if (!labels_file.read(reinterpret_cast<char*>(&label), sizeof(label))) {
-				std::cerr << "cannot read label" << std::endl;
-				return labels;
+			if (readBigEndian(dimension) != expected)
+			{
+				std::cerr << "invalid dimensions" << std::endl;
+				return 0;
 			}
-
-			labels.push_back(label);
+			dimension += sizeof(std::uint32_t);
 		}
 
-		return labels;
+		if ((file.size() - header_size) / item_size < count)
+		{
+			std::cerr << "file is truncated" << std::endl;
+			return 0;
+		}
+		items = file.data() + header_size;
+		return count;
 	}
 
-	mnist::ImagesData imagesDataFromFile(const std::string& file)
+	mnist::Labels labelsFromFile(const std::string& file)
 	{
-		mnist::ImagesData images;
-		std::ifstream images_file(file, std::ios::binary);
-		if (!images_file) {
-			std::cerr << "no such file" << std::endl;
-			return images;
-		}
-
-		int magic {};
-		if (!images_file.read(reinterpret_cast<char*>(&magic), sizeof(magic))) {
-			std::cerr << "cannot read header" << std::endl;
-			return images;
-		}
-
-		magic = _byteswap_ulong(magic);
+		const auto mapping = mapFile(file);
+		const unsigned char* labels {};
+		const std::size_t count = mapping ? readHeader(*mapping, LabelsMagic, {}, 1, labels) : 0;
 
-		if (magic != 0x00000803) {
-			std::cerr << "not a valid file" << std::endl;
-			return images;
-		}
+		return mnist::Labels(labels, labels + count);
+	}
 
-		int count {};
-		if (!images_file.read(reinterpret_cast<char*>(&count), sizeof(count))) {
-			std::cerr << "cannot read size" << std::endl;
-			return images;
-		}
+	template <typename T>
+	mnist::ImagesData<T> imagesDataFromFile(const std::string& file)
+	{
+		const auto mapping = mapFile(file);
+		const unsigned char* pixels {};
+		const std::size_t count = mapping
+			? readHeader(*mapping, ImagesMagic, { mnist::ImageHeight, mnist::ImageWidth }, mnist::ImagePixelCount, pixels)
+			: 0;
+
+		// the workers fault in their own part of the mapping
+		mnist::ImagesData<T> images(count);
+		parallel_for(0, count, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i = first; i < last; i++)
+			{
+				images[i].resize(mnist::ImagePixelCount);
+				kernels::normalizeBytes(mnist::ImagePixelCount, pixels + i * mnist::ImagePixelCount, T(255), images[i].data());
+			}
+		});
 
-		count = _byteswap_ulong(count);
+		return images;
+	}
 
-		int width {};
-		if (!images_file.read(reinterpret_cast<char*>(&width), sizeof(width))) {
-			std::cerr << "cannot read width" << std::endl;
-			return images;
-		}
-		width = _byteswap_ulong(width);
-		if (width != mnist::ImageWidth) {
-			std::cerr << "invalid width" << std::endl;
-			return images;
+	Dataset readSet(const std::string& labels_file, const std::string& images_file)
+	{
+		auto labels = labelsFromFile(labels_file);
+		auto mapping = mapFile(images_file);
+		const unsigned char* pixels {};
+		const std::size_t count = mapping
+			? readHeader(*mapping, ImagesMagic, { mnist::ImageHeight, mnist::ImageWidth }, mnist::ImagePixelCount, pixels)
+			: 0;
+		if (count != labels.size())
+		{
+			std::cerr << "labels and images don't match" << std::endl;
+			return {};
 		}
 
-		int height {};
-		if (!images_file.read(reinterpret_cast<char*>(&height), sizeof(height))) {
-			std::cerr << "cannot read height" << std::endl;
-			return images;
-		}
-		height = _byteswap_ulong(height);
-		if (height != mnist::ImageHeight) {
-			std::cerr << "invalid height" << std::endl;
-			return images;
-		}
+		const util::span<const std::uint8_t> samples(pixels, count * mnist::ImagePixelCount);
+		return Dataset(mnist::ImagePixelCount, std::move(mapping), samples, std::move(labels));
+	}
 
-		for (int i {}; i < count; i++)
-		{
-			std::array<unsigned char, mnist::ImagePixelCount> image_data;
-			if (!images_file.read(reinterpret_cast<char*>(image_data.data()), image_data.size())) {
-				std::cerr << "cannot read label" << std::endl;
-				return images;
-			}
+	template <typename T>
+	mnist::Data<T> readData(const std::string& labels_file, const std::string& images_file)
+	{
+		return { imagesDataFromFile<T>(images_file), labelsFromFile(labels_file) };
+	}
+}
 
-			mnist::ImageData normalized;
-			normalized.reserve(mnist::ImagePixelCount);
-			std::transform(image_data.begin(), image_data.end(), std::back_inserter(normalized), [](auto pix){ return pix / 255.; });
-			images.push_back(normalized);
-		}
+template <typename T>
+mnist::Data<T> mnist::readTrainingData(const std::string& directory)
+{
+	return readData<T>(directory + "train-labels.idx1-ubyte", directory + "train-images.idx3-ubyte");
+}
 
-		return images;
-	}
+template <typename T>
+mnist::Data<T> mnist::readTestData(const std::string& directory)
+{
+	return readData<T>(directory + "t10k-labels.idx1-ubyte", directory + "t10k-images.idx3-ubyte");
 }
 
-mnist::Data mnist::readTrainingData(const std::string& directory)
+Dataset mnist::readTrainingSet(const std::string& directory)
 {
-	const auto labels = labelsFromFile(directory + "train-labels.idx1-ubyte");
-	const auto images = imagesDataFromFile(directory + "train-images.idx3-ubyte");
+	return readSet(directory + "train-labels.idx1-ubyte", directory + "train-images.idx3-ubyte");
+}
 
-	return { images, labels };
+Dataset mnist::readTestSet(const std::string& directory)
+{
+	return readSet(directory + "t10k-labels.idx1-ubyte", directory + "t10k-images.idx3-ubyte");
 }
+
+template mnist::Data<float> mnist::readTrainingData<float>(const std::string& directory);
+template mnist::Data<double> mnist::readTrainingData<double>(const std::string& directory);
+template mnist::Data<float> mnist::readTestData<float>(const std::string& directory);
+template mnist::Data<double> mnist::readTestData<double>(const std::string& directory);
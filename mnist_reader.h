@@ -1,9 +1,19 @@
 #pragma once
 
+#include "dataset.h"
 #include "mnist_image_defs.h"
 
 namespace mnist
 {
-	mnist::Data readTrainingData(const std::string& directory);
-	mnist::Data readTestData(const std::string& directory);
+	// Map the IDX files of the MNIST training or test set (directory is
+	// prepended to the file names) and normalize the pixels to [0, 1] on all
+	// threads. Errors are reported on std::cerr and leave the data empty.
+	template <typename T = double>
+	mnist::Data<T> readTrainingData(const std::string& directory);
+	template <typename T = double>
+	mnist::Data<T> readTestData(const std::string& directory);
+
+	// The same sets as raw pixels, straight from the mapped image file.
+	Dataset readTrainingSet(const std::string& directory);
+	Dataset readTestSet(const std::string& directory);
 }
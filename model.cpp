@@ -0,0 +1,277 @@
+#include "model.h"
+
+#include "kernels.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	const char Magic[8] { 'N', 'E', 'U', 'R', 'A', 'L', 'M', 'D' };
+	const std::uint32_t Version = 1;
+	const std::uint32_t ByteOrderMark = 0x01020304;
+
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byteOrder;
+		std::uint32_t scalarSize;
+		std::uint32_t activation;
+		std::uint64_t layerCount;
+		std::uint64_t parameterOffset;
+		std::uint64_t parameterCount;
+	};
+}
+
+
+template <typename T>
+Model<T>::Model(const Network<T>& network)
+	: activationType(network.activation())
+	, activationFunction(network.activationFunction)
+{
+	const auto arena = std::make_shared<util::Arena<T>>(network.parameterCount);
+	std::memcpy(arena->data(), network.storage.data(), network.parameterCount * sizeof(T));
+	storage = arena;
+	parameters = { arena->data(), network.parameterCount };
+
+	bind(network.architecture());
+}
+
+template <typename T>
+void Model<T>::bind(const Architecture& architecture)
+{
+	const T* block = parameters.data();
+	for (std::size_t i {}; i < architecture.size(); i++)
+	{
+		const std::size_t size = architecture[i];
+		const std::size_t previous_size = (i > 0) ? architecture[i - 1] : 0;
+
+		const util::span<const T> weights { block, size * previous_size };
+		block += util::padded<T>(size * previous_size);
+		const util::span<const T> biases { block, size };
+		block += util::padded<T>(size);
+
+		layerParameters.push_back({ size, previous_size, weights, biases });
+		maxSize = std::max(maxSize, size);
+	}
+}
+
+template <typename T>
+void Model<T>::save(const std::string& path) const
+{
+	if (activationType == Activation::Custom)
+	{
+		throw std::runtime_error("Custom activations can't be saved");
+	}
+
+	const auto sizes = architecture();
+	const std::size_t header_size = sizeof(FileHeader) + sizes.size() * sizeof(std::uint64_t);
+	const std::size_t offset = (header_size + util::CacheLineSize - 1) / util::CacheLineSize * util::CacheLineSize;
+
+	FileHeader header {};
+	std::copy(std::begin(Magic), std::end(Magic), header.magic);
+	header.version = Version;
+	header.byteOrder = ByteOrderMark;
+	header.scalarSize = sizeof(T);
+	header.activation = std::uint32_t(activationType);
+	header.layerCount = sizes.size();
+	header.parameterOffset = offset;
+	header.parameterCount = parameters.size();
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const std::uint64_t size : sizes)
+	{
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	}
+	const char padding[util::CacheLineSize] {};
+	file.write(padding, offset - header_size);
+	file.write(reinterpret_cast<const char*>(parameters.data()), parameters.size() * sizeof(T));
+
+	if (!file.flush())
+	{
+		throw std::runtime_error("Cannot write " + path);
+	}
+}
+
+template <typename T>
+Model<T> Model<T>::load(const std::string& path)
+{
+	const auto file = std::make_shared<util::MappedFile>(path);
+
+	FileHeader header {};
+	if (file->size() < sizeof(header))
+	{
+		throw std::runtime_error(path + " is not a model file");
+	}
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (!std::equal(std::begin(Magic), std::end(Magic), header.magic))
+	{
+		throw std::runtime_error(path + " is not a model file");
+	}
+	if (header.version != Version || header.byteOrder != ByteOrderMark)
+	{
+		throw std::runtime_error(path + " has an unsupported version or byte order");
+	}
+	if (header.scalarSize != sizeof(T))
+	{
+		throw std::runtime_error(path + " holds parameters of a different type");
+	}
+	// sizes are compared by dividing what is left, so crafted values can't wrap
+	if (header.layerCount < 2 || header.activation >= std::uint32_t(Activation::Custom)
+		|| header.parameterOffset % util::CacheLineSize != 0
+		|| header.parameterOffset < sizeof(header) || header.parameterOffset > file->size()
+		|| header.layerCount > (header.parameterOffset - sizeof(header)) / sizeof(std::uint64_t)
+		|| header.parameterCount > (file->size() - header.parameterOffset) / sizeof(T))
+	{
+		throw std::runtime_error(path + " is damaged");
+	}
+
+	Architecture sizes(header.layerCount);
+	std::uint64_t expected_count {};
+	for (std::size_t i {}; i < sizes.size(); i++)
+	{
+		std::uint64_t size;
+		std::memcpy(&size, file->data() + sizeof(header) + i * sizeof(size), sizeof(size));
+		const std::uint64_t previous_size = i > 0 ? sizes[i - 1] : 0;
+		const std::uint64_t left = header.parameterCount - expected_count;
+		if (size == 0 || size > left || (previous_size > 0 && size > left / previous_size))
+		{
+			throw std::runtime_error(path + " is damaged");
+		}
+		// both at most the parameter count, so padding them doesn't wrap
+		const std::uint64_t layer_count = util::padded<T>(size * previous_size) + util::padded<T>(size);
+		if (layer_count > left)
+		{
+			throw std::runtime_error(path + " is damaged");
+		}
+		sizes[i] = size;
+		expected_count += layer_count;
+	}
+	if (expected_count != header.parameterCount)
+	{
+		throw std::runtime_error(path + " is damaged");
+	}
+
+	Model result;
+	result.activationType = Activation(header.activation);
+	result.parameters = { reinterpret_cast<const T*>(file->data() + header.parameterOffset), header.parameterCount };
+	result.storage = file;
+	result.bind(sizes);
+	return result;
+}
+
+template <typename T>
+Architecture Model<T>::architecture() const
+{
+	Architecture result;
+	for (const auto& layer : layerParameters)
+	{
+		result.push_back(layer.size);
+	}
+	return result;
+}
+
+template <typename T>
+util::span<const T> Model<T>::predict(util::span<const T> input, InferenceContext<T>& context) const
+{
+	context.reserve(maxSize);
+
+	const T* previous_activations = input.data();
+	for (std::size_t layer = 1; layer < layerParameters.size(); layer++)
+	{
+		const auto& current_layer = layerParameters[layer];
+		T* activations = context.buffers[layer % 2].data();
+
+		std::copy(current_layer.biases.begin(), current_layer.biases.end(), activations);
+		kernels::gemv(current_layer.size, current_layer.previousSize, current_layer.weights.data(), current_layer.previousSize, previous_activations, activations);
+
+		activate(current_layer.size, activations);
+		previous_activations = activations;
+	}
+
+	return { previous_activations, outputSize() };
+}
+
+template <typename T>
+int Model<T>::classify(util::span<const T> input, InferenceContext<T>& context) const
+{
+	return util::argmax(predict(input, context));
+}
+
+template <typename T>
+util::span<const T> Model<T>::predictBatch(util::span<const std::vector<T>> inputs, InferenceContext<T>& context) const
+{
+	const std::size_t samples = inputs.size();
+	context.reserve(samples * maxSize);
+
+	T* previous_activations = context.buffers[0].data();
+	for (std::size_t s {}; s < samples; s++)
+	{
+		std::copy(inputs[s].begin(), inputs[s].end(), previous_activations + s * inputSize());
+	}
+
+	// Z = A_prev * W^T + b
+	for (std::size_t layer = 1; layer < layerParameters.size(); layer++)
+	{
+		const auto& current_layer = layerParameters[layer];
+		const std::size_t size = current_layer.size;
+		const std::size_t inputs_count = current_layer.previousSize;
+		T* activations = context.buffers[layer % 2].data();
+
+		for (std::size_t s {}; s < samples; s++)
+		{
+			std::copy(current_layer.biases.begin(), current_layer.biases.end(), activations + s * size);
+		}
+		kernels::gemm(kernels::Transpose::No, kernels::Transpose::Yes, samples, size, inputs_count,
+					  previous_activations, inputs_count, current_layer.weights.data(), inputs_count, activations, size);
+
+		activate(samples * size, activations);
+		previous_activations = activations;
+	}
+
+	return { previous_activations, samples * outputSize() };
+}
+
+template <typename T>
+void Model<T>::activate(std::size_t n, T* values) const
+{
+	if (activationType != Activation::Custom)
+	{
+		activation::forward(activationType, n, values, values);
+		return;
+	}
+	for (std::size_t i {}; i < n; i++)
+	{
+		values[i] = activationFunction(values[i]);
+	}
+}
+
+
+template <typename T>
+InferenceContext<T>::InferenceContext(const Model<T>& model)
+{
+	reserve(model.maxLayerSize());
+}
+
+template <typename T>
+void InferenceContext<T>::reserve(std::size_t size)
+{
+	for (auto& buffer : buffers)
+	{
+		if (buffer.size() < size)
+		{
+			buffer.resize(size);
+		}
+	}
+}
+
+template class Model<float>;
+template class Model<double>;
+template class InferenceContext<float>;
+template class InferenceContext<double>;
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "network.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+template <typename T>
+class InferenceContext;
+
+
+// Read-only snapshot of a trained Network, taken with a single copy of its
+// parameter block or mapped from a model file. predict() is const and keeps
+// every intermediate value in the caller's InferenceContext, so one Model can
+// be shared by any number of threads without locking. Copies share the
+// parameters.
+template <typename T = double>
+class Model
+{
+public:
+
+	using value_type = T;
+
+	struct LayerParameters {
+		std::size_t size {};
+		std::size_t previousSize {};
+		util::span<const T> weights {};
+		util::span<const T> biases {};
+	};
+
+	explicit Model(const Network<T>& network);
+
+	// Model file, native byte order:
+	//   header: "NEURALMD", version, byte order mark, sizeof(T), activation id,
+	//           layer count, parameter offset, parameter count
+	//   layer sizes (uint64 each)
+	//   zero padding up to the parameter offset, a multiple of 64
+	//   the parameter block: per layer the row-major weights, then the biases,
+	//   each padded to whole cache lines (Network::parameters())
+	void save(const std::string& path) const;
+	// Maps the file and runs straight from the mapped pages. Throws
+	// std::runtime_error if the file doesn't hold a model of this T.
+	static Model load(const std::string& path);
+
+	Architecture architecture() const;
+	Activation activation() const { return activationType; }
+	std::size_t inputSize() const { return layerParameters.front().size; }
+	std::size_t outputSize() const { return layerParameters.back().size; }
+	// Width of the widest layer, the scratch space a context needs.
+	std::size_t maxLayerSize() const { return maxSize; }
+
+	const std::vector<LayerParameters>& layers() const { return layerParameters; }
+
+	// The result points into the context and stays valid until its next use.
+	util::span<const T> predict(util::span<const T> input, InferenceContext<T>& context) const;
+	// Index of the largest output.
+	int classify(util::span<const T> input, InferenceContext<T>& context) const;
+	// Row-major (samples x outputSize) outputs, one matrix product per layer.
+	util::span<const T> predictBatch(util::span<const std::vector<T>> inputs, InferenceContext<T>& context) const;
+
+private:
+
+	Model() = default;
+
+	// points the layers into the parameter block
+	void bind(const Architecture& architecture);
+	void activate(std::size_t n, T* values) const;
+
+	// the arena or the file mapping that holds the parameter block
+	std::shared_ptr<const void> storage {};
+	util::span<const T> parameters {};
+	std::vector<LayerParameters> layerParameters {};
+	std::size_t maxSize {};
+
+	Activation activationType {};
+	ActivationFunction<T> activationFunction {};
+};
+
+
+// Per-thread scratch activations for Model::predict; reusable across calls
+// and across models (it grows to the widest layer seen).
+template <typename T = double>
+class InferenceContext
+{
+public:
+
+	InferenceContext() = default;
+	explicit InferenceContext(const Model<T>& model);
+
+private:
+
+	friend class Model<T>;
+	template <typename> friend class SparseModel;
+
+	void reserve(std::size_t size);
+
+	util::AlignedVector<T> buffers[2] {};
+};
+
+template <typename T>
+InferenceContext(const Model<T>&) -> InferenceContext<T>;
+
+extern template class Model<float>;
+extern template class Model<double>;
+extern template class InferenceContext<float>;
+extern template class InferenceContext<double>;
@@ -0,0 +1,203 @@
+#include "model_export.h"
+
+#include "activation.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	// hexadecimal, so the compiler reads back exactly the stored value
+	template <typename T>
+	std::string literal(T value)
+	{
+		if (!std::isfinite(value))
+		{
+			throw std::runtime_error("Non-finite parameters can't be exported");
+		}
+		std::ostringstream result;
+		result << std::hexfloat << value << (sizeof(T) == sizeof(float) ? "f" : "");
+		return result.str();
+	}
+
+	// rows of `columns` values, `PerLine` to a line
+	template <typename T>
+	void writeArray(std::ostream& out, const std::string& name, util::span<const T> values, std::size_t columns)
+	{
+		static const std::size_t PerLine = 8;
+
+		out << "alignas(64) inline constexpr value_type " << name << "[" << values.size() << "]\n{\n";
+		for (std::size_t row {}; row < values.size(); row += columns)
+		{
+			for (std::size_t i = row; i < row + columns; i += PerLine)
+			{
+				const std::size_t end = std::min(i + PerLine, row + columns);
+				out << "\t";
+				for (std::size_t c = i; c < end; c++)
+				{
+					out << literal(values[c]) << (c + 1 < end ? ", " : ",\n");
+				}
+			}
+		}
+		out << "};\n\n";
+	}
+
+	// The weights in panels of `block` rows, column after column within a
+	// panel, so a panel's sums stay in registers. The last panel is padded
+	// with zero rows.
+	template <typename T>
+	std::vector<T> panels(util::span<const T> weights, std::size_t rows, std::size_t columns, std::size_t block)
+	{
+		std::vector<T> result;
+		for (std::size_t first {}; first < rows; first += block)
+		{
+			for (std::size_t column {}; column < columns; column++)
+			{
+				for (std::size_t row = first; row < first + block; row++)
+				{
+					result.push_back(row < rows ? weights[row * columns + column] : T{});
+				}
+			}
+		}
+		return result;
+	}
+
+	// f(x) as an expression, with the library's constants
+	template <typename T>
+	std::string expression(Activation activation)
+	{
+		switch (activation)
+		{
+		case Activation::Identity: return "x";
+		case Activation::Sigmoid: return "1 / (1 + std::exp(-x))";
+		case Activation::Relu: return "x < 0 ? 0 : x";
+		case Activation::LeakyRelu: return "x < 0 ? " + literal(T(util::LeakyReluSlope)) + " * x : x";
+		case Activation::Custom: break;
+		}
+		throw std::runtime_error("Custom activations can't be exported");
+	}
+
+	bool isIdentifier(const std::string& name)
+	{
+		return !name.empty() && !std::isdigit(static_cast<unsigned char>(name.front()))
+			&& std::all_of(name.begin(), name.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+	}
+}
+
+template <typename T>
+void exportHeader(const Model<T>& model, std::ostream& out, const std::string& name)
+{
+	if (!isIdentifier(name))
+	{
+		throw std::invalid_argument("'" + name + "' is not a namespace name");
+	}
+	const std::string activation_expression = expression<T>(model.activation());
+
+	const auto& layers = model.layers();
+	std::string architecture;
+	for (const auto& layer : layers)
+	{
+		architecture += (architecture.empty() ? "" : "-") + std::to_string(layer.size);
+	}
+
+	out << "// Generated by exportHeader from a " << architecture << " " << activation::name(model.activation()) << " model.\n"
+		<< "#pragma once\n\n"
+		<< "#include <array>\n"
+		<< "#include <cmath>\n"
+		<< "#include <cstddef>\n\n"
+		<< "namespace " << name << "\n{\n\n"
+		<< "using value_type = " << (sizeof(T) == sizeof(float) ? "float" : "double") << ";\n\n"
+		<< "constexpr std::size_t Inputs = " << model.inputSize() << ";\n"
+		<< "constexpr std::size_t Outputs = " << model.outputSize() << ";\n\n";
+
+	// rows of a panel, a cache line of sums
+	const std::size_t block = util::CacheLineSize / sizeof(T);
+	out << "constexpr std::size_t Block = " << block << ";\n\n";
+	for (std::size_t l = 1; l < layers.size(); l++)
+	{
+		const std::string index = std::to_string(l);
+		const auto weights = panels(layers[l].weights, layers[l].size, layers[l].previousSize, block);
+		writeArray<T>(out, "weights" + index, weights, block);
+		writeArray(out, "biases" + index, layers[l].biases, layers[l].size);
+	}
+
+	out << "inline value_type activate(value_type x)\n{\n"
+		<< "\treturn " << activation_expression << ";\n"
+		<< "}\n\n";
+
+	out << "// output = f(weights * input + biases) a panel of Block rows at a time,\n"
+		<< "// four columns per step; all sizes are known to the compiler\n"
+		<< "template <std::size_t Size, std::size_t PreviousSize>\n"
+		<< "inline void layer(const value_type* weights, const value_type* biases, const value_type* input, value_type* output)\n{\n"
+		<< "\tfor (std::size_t first = 0; first < Size; first += Block)\n\t{\n"
+		<< "\t\tconst value_type* panel = weights + first * PreviousSize;\n"
+		<< "\t\tvalue_type sums[Block];\n"
+		<< "\t\tfor (std::size_t row = 0; row < Block; row++)\n\t\t{\n"
+		<< "\t\t\tsums[row] = first + row < Size ? biases[first + row] : 0;\n"
+		<< "\t\t}\n"
+		<< "\t\tstd::size_t column = 0;\n"
+		<< "\t\tfor (; column + 4 <= PreviousSize; column += 4)\n\t\t{\n"
+		<< "\t\t\tconst value_type* p = panel + column * Block;\n"
+		<< "\t\t\tconst value_type x0 = input[column], x1 = input[column + 1], x2 = input[column + 2], x3 = input[column + 3];\n"
+		<< "\t\t\tfor (std::size_t row = 0; row < Block; row++)\n\t\t\t{\n"
+		<< "\t\t\t\tsums[row] += p[row] * x0 + p[Block + row] * x1 + p[2 * Block + row] * x2 + p[3 * Block + row] * x3;\n"
+		<< "\t\t\t}\n"
+		<< "\t\t}\n"
+		<< "\t\tfor (; column < PreviousSize; column++)\n\t\t{\n"
+		<< "\t\t\tfor (std::size_t row = 0; row < Block; row++)\n\t\t\t{\n"
+		<< "\t\t\t\tsums[row] += panel[column * Block + row] * input[column];\n"
+		<< "\t\t\t}\n"
+		<< "\t\t}\n"
+		<< "\t\tfor (std::size_t row = 0; row < Block && first + row < Size; row++)\n\t\t{\n"
+		<< "\t\t\toutput[first + row] = activate(sums[row]);\n"
+		<< "\t\t}\n"
+		<< "\t}\n"
+		<< "}\n\n";
+
+	out << "inline std::array<value_type, Outputs> predict(const value_type* input)\n{\n";
+	for (std::size_t l = 1; l < layers.size(); l++)
+	{
+		const std::string index = std::to_string(l);
+		const std::string previous = l == 1 ? "input" : "activations" + std::to_string(l - 1) + ".data()";
+		out << "\tstd::array<value_type, " << layers[l].size << "> activations" << index << ";\n"
+			<< "\tlayer<" << layers[l].size << ", " << layers[l].previousSize << ">(weights" << index << ", biases" << index
+			<< ", " << previous << ", activations" << index << ".data());\n";
+	}
+	out << "\treturn activations" << layers.size() - 1 << ";\n"
+		<< "}\n\n";
+
+	out << "// index of the largest output, the first of equal ones\n"
+		<< "inline int classify(const value_type* input)\n{\n"
+		<< "\tconst auto output = predict(input);\n"
+		<< "\tstd::size_t largest = 0;\n"
+		<< "\tfor (std::size_t i = 1; i < Outputs; i++)\n\t{\n"
+		<< "\t\tif (output[i] > output[largest])\n\t\t{\n"
+		<< "\t\t\tlargest = i;\n"
+		<< "\t\t}\n"
+		<< "\t}\n"
+		<< "\treturn int(largest);\n"
+		<< "}\n\n"
+		<< "}\n";
+}
+
+template <typename T>
+void exportHeader(const Model<T>& model, const std::string& path, const std::string& name)
+{
+	std::ofstream file(path, std::ios::trunc);
+	exportHeader(model, file, name);
+	if (!file.flush())
+	{
+		throw std::runtime_error("Cannot write " + path);
+	}
+}
+
+template void exportHeader<float>(const Model<float>&, std::ostream&, const std::string&);
+template void exportHeader<double>(const Model<double>&, std::ostream&, const std::string&);
+template void exportHeader<float>(const Model<float>&, const std::string&, const std::string&);
+template void exportHeader<double>(const Model<double>&, const std::string&, const std::string&);
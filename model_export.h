@@ -0,0 +1,31 @@
+#pragma once
+
+#include "model.h"
+
+#include <iosfwd>
+#include <string>
+
+
+// Writes a C++ header that compiles a frozen model into the binary, so nothing
+// is loaded at run time. The parameters become constexpr arrays and the layers
+// plain loops of constant sizes with the activation written inline, which the
+// compiler is free to unroll and vectorize; the weights are stored in panels
+// of a cache line of rows so the loops vectorize without reassociating sums.
+// Inside namespace `name` it declares
+//   using value_type = T;
+//   constexpr std::size_t Inputs, Outputs;
+//   std::array<value_type, Outputs> predict(const value_type* input);
+//   int classify(const value_type* input);
+// The header includes only the standard library. Parameters are hexadecimal
+// floating literals, read back exactly. Export a trained Network as
+// Model(network). Throws std::runtime_error for custom activations and
+// non-finite parameters, std::invalid_argument if name isn't an identifier.
+template <typename T>
+void exportHeader(const Model<T>& model, std::ostream& out, const std::string& name);
+template <typename T>
+void exportHeader(const Model<T>& model, const std::string& path, const std::string& name);
+
+extern template void exportHeader<float>(const Model<float>&, std::ostream&, const std::string&);
+extern template void exportHeader<double>(const Model<double>&, std::ostream&, const std::string&);
+extern template void exportHeader<float>(const Model<float>&, const std::string&, const std::string&);
+extern template void exportHeader<double>(const Model<double>&, const std::string&, const std::string&);
@@ -0,0 +1,124 @@
+// Generated by exportHeader from a 6-5-3 leakyRelu model.
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace model_export_fixture
+{
+
+using value_type = float;
+
+constexpr std::size_t Inputs = 6;
+constexpr std::size_t Outputs = 3;
+
+constexpr std::size_t Block = 16;
+
+alignas(64) inline constexpr value_type weights1[96]
+{
+	0x1.28p-1f, -0x1.6p-1f, -0x1.8p-2f, -0x1p-4f, 0x1p-2f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	-0x1.bp-2f, -0x1.cp-4f, 0x1.ap-3f, 0x1.08p-1f, -0x1.8p-1f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x1.4p-3f, 0x1.ep-2f, 0x1.9p-1f, -0x1.fp-2f, -0x1.6p-3f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x1.78p-1f, -0x1.1p-1f, -0x1.cp-3f, 0x1.8p-4f, 0x1.ap-2f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	-0x1.1p-2f, 0x1.8p-5f, 0x1.7p-2f, 0x1.58p-1f, -0x1.3p-1f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x1.4p-2f, 0x1.4p-1f, -0x1.48p-1f, -0x1.5p-2f, -0x1p-6f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+};
+
+alignas(64) inline constexpr value_type biases1[5]
+{
+	0x1.2p-3f, 0x1.7p-1f, -0x1.2p-2f, 0x1.3p-2f, -0x1.68p-1f,
+};
+
+alignas(64) inline constexpr value_type weights2[80]
+{
+	-0x1.4p-4f, -0x1.6p-2f, -0x1.38p-1f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x1p-1f, 0x1.ep-3f, -0x1p-5f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	-0x1p-1f, -0x1.88p-1f, 0x1.18p-1f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x1.4p-4f, -0x1.8p-3f, -0x1.dp-2f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x1.5p-1f, 0x1.9p-2f, 0x1p-3f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+	0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f, 0x0p+0f,
+};
+
+alignas(64) inline constexpr value_type biases2[3]
+{
+	-0x1.3p-2f, 0x1.2p-2f, -0x1.7p-1f,
+};
+
+inline value_type activate(value_type x)
+{
+	return x < 0 ? 0x1.47ae14p-6f * x : x;
+}
+
+// output = f(weights * input + biases) a panel of Block rows at a time,
+// four columns per step; all sizes are known to the compiler
+template <std::size_t Size, std::size_t PreviousSize>
+inline void layer(const value_type* weights, const value_type* biases, const value_type* input, value_type* output)
+{
+	for (std::size_t first = 0; first < Size; first += Block)
+	{
+		const value_type* panel = weights + first * PreviousSize;
+		value_type sums[Block];
+		for (std::size_t row = 0; row < Block; row++)
+		{
+			sums[row] = first + row < Size ? biases[first + row] : 0;
+		}
+		std::size_t column = 0;
+		for (; column + 4 <= PreviousSize; column += 4)
+		{
+			const value_type* p = panel + column * Block;
+			const value_type x0 = input[column], x1 = input[column + 1], x2 = input[column + 2], x3 = input[column + 3];
+			for (std::size_t row = 0; row < Block; row++)
+			{
+				sums[row] += p[row] * x0 + p[Block + row] * x1 + p[2 * Block + row] * x2 + p[3 * Block + row] * x3;
+			}
+		}
+		for (; column < PreviousSize; column++)
+		{
+			for (std::size_t row = 0; row < Block; row++)
+			{
+				sums[row] += panel[column * Block + row] * input[column];
+			}
+		}
+		for (std::size_t row = 0; row < Block && first + row < Size; row++)
+		{
+			output[first + row] = activate(sums[row]);
+		}
+	}
+}
+
+inline std::array<value_type, Outputs> predict(const value_type* input)
+{
+	std::array<value_type, 5> activations1;
+	layer<5, 6>(weights1, biases1, input, activations1.data());
+	std::array<value_type, 3> activations2;
+	layer<3, 5>(weights2, biases2, activations1.data(), activations2.data());
+	return activations2;
+}
+
+// index of the largest output, the first of equal ones
+inline int classify(const value_type* input)
+{
+	const auto output = predict(input);
+	std::size_t largest = 0;
+	for (std::size_t i = 1; i < Outputs; i++)
+	{
+		if (output[i] > output[largest])
+		{
+			largest = i;
+		}
+	}
+	return int(largest);
+}
+
+}
@@ -1,13 +1,37 @@
 #include "network.h"
 
+#include "kernels.h"
+
 #include <iterator>
 #include <algorithm>
 #include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// the error pass reads as many targets as there are inputs
+	void checkTargetCount(std::size_t inputs, std::size_t targets)
+	{
+		if (inputs != targets)
+		{
+			throw std::invalid_argument("Learning " + std::to_string(inputs) + " inputs from " + std::to_string(targets) + " targets");
+		}
+	}
+}
+
 
+template <typename T>
+Network<T>::Network(const Architecture& architecture, util::nondeduced_t<ActivationFunction<T>> activation, util::nondeduced_t<ActivationFunction<T>> activationDerivative, T learningRate, std::size_t batchSize)
+	: Network(architecture, Activation::Custom, learningRate, batchSize)
+{
+	activationFunction = std::move(activation);
+	activationFunctionDerivative = std::move(activationDerivative);
+}
 
-Network::Network(const Architecture& architecture, ActivationFunction activation, ActivationFunction activationDerivative, double learningRate, std::size_t batchSize)
-	: activationFunction(std::move(activation))
-	, activationFunctionDerivative(std::move(activationDerivative))
+template <typename T>
+Network<T>::Network(const Architecture& architecture, Activation activation, T learningRate, std::size_t batchSize)
+	: activationType(activation)
 	, learningRate(learningRate)
 	, batchSize(batchSize)
 {
@@ -15,160 +39,265 @@ Network::Network(const Architecture& architecture, ActivationFunction activation
 	{
 		throw std::runtime_error("Not enough layers");
 	}
+
+	std::size_t parameters {};
+	std::size_t state {};
 	for (std::size_t i {}; i < architecture.size(); i++)
 	{
 		const std::size_t& previous_layer_size = (i > 0) ? architecture[i - 1] : 0;
 		const std::size_t& layer_size = architecture[i];
 
-		layers.push_back(Layer{layer_size, previous_layer_size});
+		parameters += util::padded<T>(layer_size * previous_layer_size) + util::padded<T>(layer_size);
+		// activations, z, errors and derivatives
+		state += 4 * util::padded<T>(layer_size);
 	}
+	// the corrections are shaped like the parameters
+	storage = util::Arena<T>(2 * parameters + state);
+	parameterCount = parameters;
 
+	layers.resize(architecture.size());
+	for (std::size_t i {}; i < architecture.size(); i++)
+	{
+		auto& layer = layers[i];
+		layer.previousSize = (i > 0) ? architecture[i - 1] : 0;
+		layer.weights = storage.take(architecture[i] * layer.previousSize);
+		layer.biases = storage.take(architecture[i]);
+	}
+	for (auto& layer : layers)
+	{
+		layer.activations = storage.take(layer.size());
+		layer.z = storage.take(layer.size());
+		layer.errors = storage.take(layer.size());
+		layer.derivatives = storage.take(layer.size());
+	}
 	corrections.resize(layers.size());
+	for (std::size_t i {}; i < layers.size(); i++)
+	{
+		corrections[i] = { storage.take(layers[i].weights.size()), storage.take(layers[i].biases.size()) };
+	}
+
+	for (auto& layer : layers)
+	{
+		for (std::size_t n {}; n < layer.size(); n++)
+		{
+			const auto neuron_weights = util::randomNormalVector(layer.previousSize);
+			std::copy(neuron_weights.begin(), neuron_weights.end(), layer.neuron(n).weights.begin());
+			layer.biases[n] = static_cast<T>(util::randomNormal());
+		}
+	}
 }
-Architecture Network::architecture() const
+
+template <typename T>
+Network<T>::Network(const Network& other)
+	: layers(other.layers)
+	, corrections(other.corrections)
+	, storage(other.storage)
+	, parameterCount(other.parameterCount)
+	, batchLayers(other.batchLayers)
+	, batchCounter(other.batchCounter)
+	, activationType(other.activationType)
+	, activationFunction(other.activationFunction)
+	, activationFunctionDerivative(other.activationFunctionDerivative)
+	, learningRate(other.learningRate)
+	, batchSize(other.batchSize)
+{
+	for (auto& layer : layers)
+	{
+		for (auto* array : { &layer.weights, &layer.biases, &layer.activations, &layer.z, &layer.errors, &layer.derivatives })
+		{
+			*array = storage.rebase(*array, other.storage);
+		}
+	}
+	for (auto& correction : corrections)
+	{
+		correction.weights = storage.rebase(correction.weights, other.storage);
+		correction.biases = storage.rebase(correction.biases, other.storage);
+	}
+}
+
+template <typename T>
+Network<T>& Network<T>::operator=(const Network& other)
+{
+	return *this = Network(other);
+}
+
+template <typename T>
+typename Network<T>::OwnedCorrections Network<T>::makeCorrections() const
+{
+	OwnedCorrections result;
+	result.storage = util::Arena<T>(parameterCount);
+	for (const auto& layer : layers)
+	{
+		result.layers.push_back({ result.storage.take(layer.weights.size()), result.storage.take(layer.biases.size()) });
+	}
+	return result;
+}
+template <typename T>
+Architecture Network<T>::architecture() const
 {
 	std::vector<std::size_t> result;
-	std::transform(layers.begin(), layers.end(), std::back_inserter(result), [](const auto& layer) { return layer.neurons.size(); });
+	std::transform(layers.begin(), layers.end(), std::back_inserter(result), [](const auto& layer) { return layer.size(); });
 	return result;
 }
 
-double Network::error(const std::vector<double>& input, const std::vector<double>& output)
+template <typename T>
+T Network<T>::error(const std::vector<T>& input, const std::vector<T>& output)
 {
 	const auto result = feedForward(input);
 
-	double sum_squared_error = 0.;
+	T sum_squared_error {};
 	for (std::size_t i {}; i < result.size(); i++)
 	{
-		const double error = output[i] - result[i];
+		const T error = output[i] - result[i];
 		sum_squared_error += error * error;
 	};
 
 	return std::sqrt(sum_squared_error / output.size());
 }
 
-std::vector<double> Network::feedForward(const std::vector<double>& input)
+template <typename T>
+std::vector<T> Network<T>::feedForward(const std::vector<T>& input)
+{
+	propagate(input, false);
+
+	const auto& output = layers.back().activations;
+	return std::vector<T>(output.begin(), output.end());
+}
+
+template <typename T>
+void Network<T>::feedForward(util::span<const T> input, util::span<T> output)
+{
+	propagate(input, false);
+
+	const auto& activations = layers.back().activations;
+	std::copy(activations.begin(), activations.end(), output.begin());
+}
+
+template <typename T>
+int Network<T>::classify(util::span<const T> input)
+{
+	propagate(input, false);
+
+	return util::argmax(layers.back().activations);
+}
+
+template <typename T>
+void Network<T>::propagate(util::span<const T> input, bool training)
 {
 	layers[0].applyActivations(input);
 
 	for (std::size_t layer = 1; layer < layers.size(); layer++)
 	{
-		auto& current_layer_neurons = layers[layer].neurons;
-		auto& previous_layer_neurons = layers[layer - 1].neurons;
-		for (std::size_t n {}; n < current_layer_neurons.size(); n++)
-		{
-			current_layer_neurons[n].z = {};
-			for (std::size_t pn {}; pn < previous_layer_neurons.size(); pn++)
-			{
-				current_layer_neurons[n].z += current_layer_neurons[n].weights[pn] * previous_layer_neurons[pn].activation;
-			}
-			current_layer_neurons[n].z += current_layer_neurons[n].bias;
-			current_layer_neurons[n].activation = activationFunction(current_layer_neurons[n].z);
-		}
+		auto& current_layer = layers[layer];
+		const auto& previous_activations = layers[layer - 1].activations;
+		const std::size_t inputs = current_layer.previousSize;
+
+		std::copy(current_layer.biases.begin(), current_layer.biases.end(), current_layer.z.begin());
+		kernels::gemv(current_layer.size(), inputs, current_layer.weights.data(), inputs, previous_activations.data(), current_layer.z.data());
+
+		T* derivatives = training ? current_layer.derivatives.data() : nullptr;
+		activate(current_layer.size(), current_layer.z.data(), current_layer.activations.data(), derivatives);
 	}
+}
 
-	return layers.back().activations();
+template <typename T>
+void Network<T>::calculateLastLayerError(const std::vector<T>& expected)
+{
+	calculateLastLayerError(Targets { { &expected, 1 }, {} });
 }
 
-void Network::calculateLastLayerError(const std::vector<double>& expected)
+template <typename T>
+void Network<T>::calculateLastLayerError(const Targets& expected)
 {
-	const auto& last_layer_neurons = layers.back().neurons;
-	auto& last_layer_errors = layers.back().errors;
+	auto& last_layer = layers.back();
 
-	for (std::size_t n {}; n < last_layer_neurons.size(); n++)
+	for (std::size_t n {}; n < last_layer.size(); n++)
 	{
-		last_layer_errors[n] = (last_layer_neurons[n].activation - expected[n]) * activationFunctionDerivative(last_layer_neurons[n].z);
+		last_layer.errors[n] = last_layer.activations[n] - expected(0, n);
 	}
+	multiplyByDerivative(last_layer.size(), last_layer.derivatives.data(), last_layer.errors.data());
 }
 
-void Network::calculateInnerLayersError()
+template <typename T>
+void Network<T>::calculateInnerLayersError()
 {
 	for (int layer = layers.size() - 2; layer >= 1; --layer)
 	{
-		const auto& current_layer_neurons = layers[layer].neurons;
-		auto& current_layer_errors = layers[layer].errors;
+		auto& current_layer = layers[layer];
+		const auto& next_layer = layers[layer + 1];
 
-		const auto& next_layer_neurons = layers[layer + 1].neurons;
-		const auto& next_layer_errors = layers[layer + 1].errors;
+		std::fill(current_layer.errors.begin(), current_layer.errors.end(), T{});
+		kernels::gemvT(next_layer.size(), current_layer.size(), next_layer.weights.data(), next_layer.previousSize, next_layer.errors.data(), current_layer.errors.data());
 
-		for (std::size_t n {}; n < current_layer_neurons.size(); n++)
-		{
-			double current_error = {};
-			for (std::size_t nn {}; nn < next_layer_neurons.size(); nn++)
-			{
-				current_error += next_layer_neurons[nn].weights[n] * next_layer_errors[nn];
-			}
-			current_error *= activationFunctionDerivative(current_layer_neurons[n].z);
-			current_layer_errors[n] = current_error;
-		}
+		multiplyByDerivative(current_layer.size(), current_layer.derivatives.data(), current_layer.errors.data());
 	}
 }
 
-void Network::updateWeightsAndBiases(std::vector<Network::LayerCorrection>& updates)
+template <typename T>
+void Network<T>::updateWeightsAndBiases(std::vector<typename Network<T>::LayerCorrection>& updates)
 {
 	for (int layer = layers.size() - 1; layer >= 1; --layer)
 	{
-		auto& current_layer_neurons = layers[layer].neurons;
-		const auto& current_layer_errors = layers[layer].errors;
-		const auto& previous_layer_neurons = layers[layer - 1].neurons;
-		auto& current_layer_updates = updates[layer];
-		current_layer_updates.neurons.resize(current_layer_neurons.size());
-
-		for (std::size_t n {}; n < current_layer_neurons.size(); n++)
-		{
-			auto& current_neuron = current_layer_neurons[n];
-			auto& current_updates = current_layer_updates.neurons[n];
-			current_updates.weights.resize(current_neuron.weights.size());
-
-			for (std::size_t pn {}; pn < current_neuron.weights.size(); pn++)
-			{
-				const auto weight_correction = current_layer_errors[n] * previous_layer_neurons[pn].activation;
-				current_updates.weights[pn] += weight_correction;
-			}
+		const auto& current_layer = layers[layer];
+		const auto& previous_activations = layers[layer - 1].activations;
+		auto& current_updates = updates[layer];
+		const std::size_t inputs = current_layer.previousSize;
 
-			const auto bias_correction = current_layer_errors[n];
-			current_updates.bias += bias_correction;
-		}
+		kernels::ger(current_layer.size(), inputs, T{1}, current_layer.errors.data(), previous_activations.data(), current_updates.weights.data(), inputs);
+		kernels::axpy(current_layer.size(), T{1}, current_layer.errors.data(), current_updates.biases.data());
 	}
 }
 
-void Network::correctWeightsAndBiases(std::vector<Network::LayerCorrection>& updates)
+template <typename T>
+void Network<T>::correctWeightsAndBiases(std::vector<typename Network<T>::LayerCorrection>& updates)
+{
+	applyCorrections(updates, learningRate / T(batchSize));
+}
+
+template <typename T>
+void Network<T>::applyCorrections(std::vector<typename Network<T>::LayerCorrection>& updates, T rate)
 {
 	for (int layer = layers.size() - 1; layer >= 1; --layer)
 	{
-		auto& current_layer_neurons = layers[layer].neurons;
-		auto& current_layer_updates = updates[layer];
-
-		for (std::size_t n {}; n < current_layer_neurons.size(); n++)
-		{
-			auto& current_neuron = current_layer_neurons[n];
-			auto& current_updates = current_layer_updates.neurons[n];
+		auto& current_layer = layers[layer];
+		auto& current_updates = updates[layer];
 
-			for (std::size_t pn {}; pn < current_neuron.weights.size(); pn++)
-			{
-				current_neuron.weights[pn] -= current_updates.weights[pn] * learningRate / batchSize;
-				current_updates.weights[pn] = {};
-			}
+		kernels::axpy(current_layer.weights.size(), -rate, current_updates.weights.data(), current_layer.weights.data());
+		kernels::axpy(current_layer.biases.size(), -rate, current_updates.biases.data(), current_layer.biases.data());
 
-			current_neuron.bias -= current_updates.bias * learningRate / batchSize;
-			current_updates.bias = {};
-		}
+		std::fill(current_updates.weights.begin(), current_updates.weights.end(), T{});
+		std::fill(current_updates.biases.begin(), current_updates.biases.end(), T{});
 	}
 }
 
 
 
-void Network::clearErrors()
+template <typename T>
+void Network<T>::clearErrors()
 {
 	for (int layer = layers.size() - 1; layer >= 1; --layer)
 	{
 		auto& current_layer_errors = layers[layer].errors;
-		std::fill(current_layer_errors.begin(), current_layer_errors.end(), 0.);
+		std::fill(current_layer_errors.begin(), current_layer_errors.end(), T{});
 	}
 }
 
-void Network::learnOnce(const std::vector<double>& input, const std::vector<double>& expected)
+template <typename T>
+void Network<T>::learnOnce(const std::vector<T>& input, const std::vector<T>& expected)
 {
-	feedForward(input);
+	learnSample(input, Targets { { &expected, 1 }, {} });
+}
+
+template <typename T>
+void Network<T>::learnOnce(const std::vector<T>& input, int label)
+{
+	learnSample(input, Targets { {}, { &label, 1 } });
+}
+
+template <typename T>
+void Network<T>::learnSample(util::span<const T> input, const Targets& expected)
+{
+	propagate(input, true);
 
 	clearErrors();
 
@@ -176,8 +305,6 @@ void Network::learnOnce(const std::vector<double>& input, const std::vector<doub
 
 	calculateInnerLayersError();
 
-	static std::size_t batchCounter = 0;
-
 	updateWeightsAndBiases(corrections);
 	batchCounter++;
 
@@ -190,35 +317,270 @@ void Network::learnOnce(const std::vector<double>& input, const std::vector<doub
 
 }
 
+template <typename T>
+void Network<T>::learnBatch(util::span<const std::vector<T>> inputs, util::span<const std::vector<T>> expected)
+{
+	checkTargetCount(inputs.size(), expected.size());
+	const std::size_t samples = inputs.size();
+	if (samples == 0)
+	{
+		return;
+	}
+
+	accumulateGradients(inputs, Targets { expected, {} }, batchLayers, corrections);
+
+	applyGradients(corrections, samples + batchCounter);
+	batchCounter = 0;
+}
+
+template <typename T>
+void Network<T>::learnBatch(util::span<const std::vector<T>> inputs, util::span<const int> labels)
+{
+	checkTargetCount(inputs.size(), labels.size());
+	const std::size_t samples = inputs.size();
+	if (samples == 0)
+	{
+		return;
+	}
+
+	accumulateGradients(inputs, Targets { {}, labels }, batchLayers, corrections);
+
+	applyGradients(corrections, samples + batchCounter);
+	batchCounter = 0;
+}
+
+template <typename T>
+void Network<T>::accumulateGradients(util::span<const std::vector<T>> inputs, const Targets& expected,
+									 BatchWorkspace& workspace, std::vector<LayerCorrection>& updates) const
+{
+	checkTargetCount(inputs.size(), expected.size());
+	const std::size_t samples = inputs.size();
+	if (samples == 0)
+	{
+		return;
+	}
+
+	prepareBatch(workspace, samples);
+
+	const std::size_t input_size = layers[0].size();
+	auto& input_activations = workspace[0].activations;
+	for (std::size_t s {}; s < samples; s++)
+	{
+		std::copy(inputs[s].begin(), inputs[s].end(), input_activations.begin() + s * input_size);
+	}
+
+	feedForwardBatch(workspace, samples);
+	calculateBatchErrors(workspace, expected);
+	updateWeightsAndBiasesBatch(workspace, samples, updates);
+}
+
+template <typename T>
+void Network<T>::learnOnceUnsynchronized(const std::vector<T>& input, const Targets& expected, std::size_t sample, BatchWorkspace& workspace)
+{
+	prepareBatch(workspace, 1);
+	std::copy(input.begin(), input.end(), workspace[0].activations.begin());
+
+	for (std::size_t layer = 1; layer < layers.size(); layer++)
+	{
+		const auto& current_layer = layers[layer];
+		const std::size_t inputs = current_layer.previousSize;
+		auto& state = workspace[layer];
+
+		std::copy(current_layer.biases.begin(), current_layer.biases.end(), state.z.begin());
+		kernels::gemv(current_layer.size(), inputs, current_layer.weights.data(), inputs, workspace[layer - 1].activations.data(), state.z.data());
+
+		activate(current_layer.size(), state.z.data(), state.activations.data(), state.derivatives.data());
+	}
 
-Layer::Layer(size_t size, size_t previousLayerSize)
-	: neurons( util::randomVector<Neuron>(size, [=]{ return Neuron(previousLayerSize); }) )
-	, errors( size )
+	auto& last_state = workspace.back();
+	for (std::size_t n {}; n < layers.back().size(); n++)
+	{
+		last_state.errors[n] = last_state.activations[n] - expected(sample, n);
+	}
+	multiplyByDerivative(layers.back().size(), last_state.derivatives.data(), last_state.errors.data());
+
+	for (int layer = layers.size() - 2; layer >= 1; --layer)
+	{
+		const auto& next_layer = layers[layer + 1];
+		const std::size_t size = layers[layer].size();
+		auto& state = workspace[layer];
+
+		std::fill(state.errors.begin(), state.errors.begin() + size, T{});
+		kernels::gemvT(next_layer.size(), size, next_layer.weights.data(), next_layer.previousSize, workspace[layer + 1].errors.data(), state.errors.data());
+		multiplyByDerivative(size, state.derivatives.data(), state.errors.data());
+	}
+
+	// same step per sample as learnOnce averaged over a mini-batch
+	const T rate = learningRate / T(batchSize);
+	for (std::size_t layer = 1; layer < layers.size(); layer++)
+	{
+		auto& current_layer = layers[layer];
+		const std::size_t inputs = current_layer.previousSize;
+		const auto& errors = workspace[layer].errors;
+
+		kernels::ger(current_layer.size(), inputs, -rate, errors.data(), workspace[layer - 1].activations.data(), current_layer.weights.data(), inputs);
+		kernels::axpy(current_layer.size(), -rate, errors.data(), current_layer.biases.data());
+	}
+}
+
+template <typename T>
+void Network<T>::applyGradients(std::vector<LayerCorrection>& updates, std::size_t samples)
 {
+	applyCorrections(updates, learningRate / T(samples));
 }
 
-void Layer::applyActivations(const std::vector<double>& activations)
+template <typename T>
+void Network<T>::prepareBatch(BatchWorkspace& workspace, std::size_t samples) const
 {
-	for (size_t i{}; i < activations.size(); ++i)
+	// only grows, so uneven splits of the mini-batches do not reallocate
+	workspace.resize(layers.size());
+	for (std::size_t layer {}; layer < layers.size(); layer++)
 	{
-		neurons[i].activation = activations[i];
+		const std::size_t size = samples * layers[layer].size();
+		auto& batch_layer = workspace[layer];
+		if (batch_layer.activations.size() < size)
+		{
+			batch_layer.activations.resize(size);
+			batch_layer.z.resize(size);
+			batch_layer.errors.resize(size);
+			batch_layer.derivatives.resize(size);
+		}
 	}
 }
 
-std::vector<double> Layer::activations() const
+template <typename T>
+void Network<T>::feedForwardBatch(BatchWorkspace& workspace, std::size_t samples) const
 {
-	std::vector<double> activations;
-	activations.reserve(neurons.size());
-	for (const auto& n : neurons)
+	// Z = A_prev * W^T + b, one (samples x size) matrix per layer
+	for (std::size_t layer = 1; layer < layers.size(); layer++)
 	{
-		activations.push_back(n.activation);
+		const auto& current_layer = layers[layer];
+		const std::size_t size = current_layer.size();
+		const std::size_t inputs = current_layer.previousSize;
+		const auto& previous_activations = workspace[layer - 1].activations;
+		auto& batch_layer = workspace[layer];
+
+		for (std::size_t s {}; s < samples; s++)
+		{
+			std::copy(current_layer.biases.begin(), current_layer.biases.end(), batch_layer.z.begin() + s * size);
+		}
+		kernels::gemm(kernels::Transpose::No, kernels::Transpose::Yes, samples, size, inputs,
+					  previous_activations.data(), inputs, current_layer.weights.data(), inputs, batch_layer.z.data(), size);
+
+		activate(samples * size, batch_layer.z.data(), batch_layer.activations.data(), batch_layer.derivatives.data());
 	}
-	return activations;
 }
 
-Neuron::Neuron(size_t inputs)
-	: weights{ util::randomNormalVector(inputs) }
-	, bias { util::randomNormal() }
+template <typename T>
+void Network<T>::calculateBatchErrors(BatchWorkspace& workspace, const Targets& expected) const
+{
+	const std::size_t samples = expected.size();
+	{
+		auto& last_batch_layer = workspace.back();
+		const std::size_t size = layers.back().size();
+		for (std::size_t s {}; s < samples; s++)
+		{
+			for (std::size_t n {}; n < size; n++)
+			{
+				const std::size_t i = s * size + n;
+				last_batch_layer.errors[i] = last_batch_layer.activations[i] - expected(s, n);
+			}
+		}
+		multiplyByDerivative(samples * size, last_batch_layer.derivatives.data(), last_batch_layer.errors.data());
+	}
+
+	// E = (E_next * W_next) .* f'(Z)
+	for (int layer = layers.size() - 2; layer >= 1; --layer)
+	{
+		const auto& next_layer = layers[layer + 1];
+		const std::size_t size = layers[layer].size();
+		const std::size_t next_size = next_layer.size();
+		auto& batch_layer = workspace[layer];
+		const auto& next_errors = workspace[layer + 1].errors;
+
+		std::fill(batch_layer.errors.begin(), batch_layer.errors.begin() + samples * size, T{});
+		kernels::gemm(kernels::Transpose::No, kernels::Transpose::No, samples, size, next_size,
+					  next_errors.data(), next_size, next_layer.weights.data(), size, batch_layer.errors.data(), size);
+
+		multiplyByDerivative(samples * size, batch_layer.derivatives.data(), batch_layer.errors.data());
+	}
+}
+
+template <typename T>
+void Network<T>::updateWeightsAndBiasesBatch(const BatchWorkspace& workspace, std::size_t samples, std::vector<typename Network<T>::LayerCorrection>& updates) const
+{
+	// dW += E^T * A_prev, db += column sums of E
+	for (int layer = layers.size() - 1; layer >= 1; --layer)
+	{
+		const std::size_t size = layers[layer].size();
+		const std::size_t inputs = layers[layer].previousSize;
+		const auto& errors = workspace[layer].errors;
+		const auto& previous_activations = workspace[layer - 1].activations;
+		auto& current_updates = updates[layer];
+
+		kernels::gemm(kernels::Transpose::Yes, kernels::Transpose::No, size, inputs, samples,
+					  errors.data(), size, previous_activations.data(), inputs, current_updates.weights.data(), inputs);
+
+		for (std::size_t s {}; s < samples; s++)
+		{
+			kernels::axpy(size, T{1}, &errors[s * size], current_updates.biases.data());
+		}
+	}
+}
+
+
+template <typename T>
+void Network<T>::activate(std::size_t n, const T* z, T* activations, T* derivatives) const
+{
+	if (activationType != Activation::Custom)
+	{
+		if (derivatives)
+		{
+			activation::forward(activationType, n, z, activations, derivatives);
+		}
+		else
+		{
+			activation::forward(activationType, n, z, activations);
+		}
+		return;
+	}
+	for (std::size_t i {}; i < n; i++)
+	{
+		activations[i] = activationFunction(z[i]);
+	}
+	if (derivatives)
+	{
+		for (std::size_t i {}; i < n; i++)
+		{
+			derivatives[i] = activationFunctionDerivative(z[i]);
+		}
+	}
+}
+
+template <typename T>
+void Network<T>::multiplyByDerivative(std::size_t n, const T* derivatives, T* errors) const
+{
+	if (activationType == Activation::Identity)
+	{
+		return;
+	}
+	kernels::multiply(n, derivatives, errors);
+}
+
+
+template <typename T>
+Neuron<T> Layer<T>::neuron(std::size_t n)
+{
+	return { { weights.data() + n * previousSize, previousSize }, biases[n], activations[n], z[n] };
+}
+
+template <typename T>
+void Layer<T>::applyActivations(util::span<const T> activations)
 {
+	std::copy(activations.begin(), activations.end(), this->activations.begin());
 }
 
+template struct Layer<float>;
+template struct Layer<double>;
+template class Network<float>;
+template class Network<double>;
@@ -1,68 +1,172 @@
 #pragma once
 
+#include "activation.h"
+#include "arena.h"
 #include "util.h"
 
 #include <vector>
 #include <functional>
 
-using ActivationFunction = std::function<double(double)>;
+template <typename T>
+using ActivationFunction = std::function<T(T)>;
 using Architecture = std::vector<std::size_t>;
 
 
+// A view of one neuron's parameters and state inside its Layer's arrays.
+template <typename T>
 struct Neuron
 {
-	Neuron(std::size_t inputs = 0);
-
-	double activation {};
-	double z {};
-
-	std::vector<double> weights {};
-	double bias {};
+	util::span<T> weights;
+	T& bias;
 
+	T& activation;
+	T& z;
 };
 
 
+// Structure-of-arrays layer: weights are stored as a single row-major
+// (size x previousSize) matrix, so weights[n * previousSize + pn] connects
+// neuron n with neuron pn of the previous layer.
+//
+// The arrays are views into the owning Network's arena. A copied Layer still
+// refers to the same arrays, so layers can't be assigned to each other.
+template <typename T>
 struct Layer
 {
-	Layer(std::size_t size = 0, std::size_t previousLayerSize = 0);
+	Layer() = default;
+	Layer(const Layer&) = default;
+	Layer& operator=(const Layer&) = delete;
+
+	std::size_t size() const { return biases.size(); }
+	Neuron<T> neuron(std::size_t n);
+
+	void applyActivations(util::span<const T> activations);
 
-	void applyActivations(const std::vector<double>& activations);
-	std::vector<double> activations() const;
+	std::size_t previousSize {};
 
-	std::vector<Neuron> neurons {};
-	std::vector<double> errors {};
+	util::span<T> weights {};
+	util::span<T> biases {};
+
+	util::span<T> activations {};
+	util::span<T> z {};
+	util::span<T> errors {};
+	// f'(z), written by training forward passes only
+	util::span<T> derivatives {};
 };
 
 
+template <typename T = double>
 class Network
 {
 public:
 
+	using value_type = T;
+
+	Network(const Architecture& architecture,
+			Activation activation = Activation::Identity,
+			T learningRate = 0.3,
+			std::size_t batchSize = 1);
+
+	// Slow path: the callbacks are called once per neuron.
 	Network(const Architecture& architecture,
-			ActivationFunction activation = &util::identity,
-			ActivationFunction activationDerivative = &util::identityPrime,
-			double learningRate = 0.3,
+			util::nondeduced_t<ActivationFunction<T>> activation,
+			util::nondeduced_t<ActivationFunction<T>> activationDerivative,
+			T learningRate = 0.3,
 			std::size_t batchSize = 1);
 
+	// Copies the arena in one go and points the layers at the copy.
+	Network(const Network& other);
+	Network(Network&&) = default;
+	Network& operator=(const Network& other);
+	Network& operator=(Network&&) = default;
+
 	Architecture architecture() const;
-	double error(const std::vector<double>& input, const std::vector<double>& output);
+	Activation activation() const { return activationType; }
+	T error(const std::vector<T>& input, const std::vector<T>& output);
 
 	struct LayerCorrection {
-		struct NeuronCorrections {
-			std::vector<double> weights {};
-			double bias {};
-		};
-		std::vector<NeuronCorrections> neurons {};
+		util::span<T> weights {};
+		util::span<T> biases {};
+	};
+
+	// Corrections with an arena of their own, for accumulating apart from the
+	// network. Move only, a copy would share the arrays.
+	struct OwnedCorrections {
+		OwnedCorrections() = default;
+		OwnedCorrections(OwnedCorrections&&) = default;
+		OwnedCorrections& operator=(OwnedCorrections&&) = default;
+
+		util::Arena<T> storage {};
+		std::vector<LayerCorrection> layers {};
 	};
 
+	// Expected outputs of consecutive samples, either as vectors or as class
+	// indices standing for one-hot vectors.
+	struct Targets {
+		util::span<const std::vector<T>> vectors {};
+		util::span<const int> labels {};
+
+		std::size_t size() const { return labels.empty() ? vectors.size() : labels.size(); }
+		T operator()(std::size_t sample, std::size_t n) const { return labels.empty() ? vectors[sample][n] : T(labels[sample] == int(n)); }
+		Targets subspan(std::size_t offset, std::size_t count) const
+		{
+			return labels.empty() ? Targets { vectors.subspan(offset, count), {} } : Targets { {}, labels.subspan(offset, count) };
+		}
+	};
 
-	std::vector<double> feedForward(const std::vector<double>& input);
-	void learnOnce(const std::vector<double>& input, const std::vector<double>& expected);
 
-	std::vector<Layer> layers {};
+	std::vector<T> feedForward(const std::vector<T>& input);
+	// Allocation free: output must hold the size of the last layer.
+	void feedForward(util::span<const T> input, util::span<T> output);
+	// Index of the largest output, allocation free.
+	int classify(util::span<const T> input);
+	void learnOnce(const std::vector<T>& input, const std::vector<T>& expected);
+	void learnOnce(const std::vector<T>& input, int label);
+
+	// Runs forward and backward passes for the whole mini-batch as matrix-matrix
+	// products and applies the averaged correction once (together with anything
+	// learnOnce accumulated so far). Allocation free once the batch size was seen.
+	// Throws std::invalid_argument unless there is a target for every input.
+	void learnBatch(util::span<const std::vector<T>> inputs, util::span<const std::vector<T>> expected);
+	void learnBatch(util::span<const std::vector<T>> inputs, util::span<const int> labels);
+
+	std::size_t miniBatchSize() const { return batchSize; }
+
+	// Row-major (samples x layer size) matrices of one mini-batch pass.
+	struct BatchLayer {
+		util::AlignedVector<T> activations {};
+		util::AlignedVector<T> z {};
+		util::AlignedVector<T> errors {};
+		util::AlignedVector<T> derivatives {};
+	};
+	using BatchWorkspace = std::vector<BatchLayer>;
+
+	// Adds the gradients of the samples to updates without changing the network,
+	// so several threads can run it at once, each with its own workspace and
+	// updates. Throws std::invalid_argument like learnBatch.
+	void accumulateGradients(util::span<const std::vector<T>> inputs, const Targets& expected,
+							 BatchWorkspace& workspace, std::vector<LayerCorrection>& updates) const;
+	// learnOnce with the state kept in the workspace and the update of every
+	// sample written straight into the shared parameters, without any
+	// synchronisation (Hogwild). Threads calling it concurrently race on the
+	// weights by design.
+	void learnOnceUnsynchronized(const std::vector<T>& input, const Targets& expected, std::size_t sample, BatchWorkspace& workspace);
+	// Applies the gradients summed over the given number of samples and clears them.
+	void applyGradients(std::vector<LayerCorrection>& updates, std::size_t samples);
+	// Zeroed corrections shaped like the layers.
+	OwnedCorrections makeCorrections() const;
+
+	// Every weight and bias, layer by layer with cache-line padding between the
+	// arrays, in one contiguous block at the start of the arena.
+	util::span<T> parameters() { return { storage.data(), parameterCount }; }
+	util::span<const T> parameters() const { return { storage.data(), parameterCount }; }
+	bool hugePages() const { return storage.hugePages(); }
+
+	std::vector<Layer<T>> layers {};
 	std::vector<LayerCorrection> corrections {};
 
-	void calculateLastLayerError(const std::vector<double>& expected);
+	// The error calculations use the derivatives cached by the last training pass.
+	void calculateLastLayerError(const std::vector<T>& expected);
 	void calculateInnerLayersError();
 	void updateWeightsAndBiases(std::vector<LayerCorrection>& updates);
 	void correctWeightsAndBiases(std::vector<LayerCorrection>& updates);
@@ -70,8 +174,37 @@ public:
 
 private:
 
-	ActivationFunction activationFunction {};
-	ActivationFunction activationFunctionDerivative {};
-	double learningRate {};
+	template <typename> friend class Model;
+
+	void propagate(util::span<const T> input, bool training);
+	void learnSample(util::span<const T> input, const Targets& expected);
+	void calculateLastLayerError(const Targets& expected);
+	void prepareBatch(BatchWorkspace& workspace, std::size_t samples) const;
+	void feedForwardBatch(BatchWorkspace& workspace, std::size_t samples) const;
+	void calculateBatchErrors(BatchWorkspace& workspace, const Targets& expected) const;
+	void updateWeightsAndBiasesBatch(const BatchWorkspace& workspace, std::size_t samples, std::vector<LayerCorrection>& updates) const;
+	void applyCorrections(std::vector<LayerCorrection>& updates, T rate);
+
+	// derivatives may be null when only the activations are needed
+	void activate(std::size_t n, const T* z, T* activations, T* derivatives) const;
+	void multiplyByDerivative(std::size_t n, const T* derivatives, T* errors) const;
+
+	// weights and biases first, then activations, z, errors, derivatives and
+	// the corrections, all sized from the architecture
+	util::Arena<T> storage {};
+	std::size_t parameterCount {};
+
+	BatchWorkspace batchLayers {};
+	std::size_t batchCounter {};
+
+	Activation activationType {};
+	ActivationFunction<T> activationFunction {};
+	ActivationFunction<T> activationFunctionDerivative {};
+	T learningRate {};
 	std::size_t batchSize {};
 };
+
+extern template struct Layer<float>;
+extern template struct Layer<double>;
+extern template class Network<float>;
+extern template class Network<double>;
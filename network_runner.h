@@ -1,6 +1,14 @@
 #pragma once
 
+#include "batch_pipeline.h"
+#include "checkpoint.h"
+#include "dataset.h"
+#include "evaluation.h"
+#include "kernels.h"
+#include "model_export.h"
 #include "network.h"
+#include "parallel_trainer.h"
+#include "pruning.h"
 #include "static_network.h"
 
 #include "mnist_reader.h"
@@ -9,20 +17,35 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <optional>
+#include <string>
 
-std::vector<mnist::ImageData> mutate(const mnist::ImageData& image)
+static const char* const DATA_DIRECTORY = "d:/dev/cpp/handreco-data/";
+static const char* const MODEL_FILE = "mnist.model";
+// the trained model compiled into a header, see exportHeader
+static const char* const MODEL_HEADER = "mnist_model.h";
+static const char* const CHECKPOINT_FILE = "mnist.checkpoint";
+// the rest of the training data is used for verification
+static const std::size_t LEARNING_SAMPLES = 50000;
+// samples per pipeline batch for training, rounded down to whole mini-batches
+static const std::size_t TRAINING_CHUNK = 1000;
+
+template <typename T>
+std::vector<mnist::ImageData<T>> mutate(const mnist::ImageData<T>& image)
 {
-	std::vector<mnist::ImageData> out;
+	std::vector<mnist::ImageData<T>> out;
 	for (int dy : { -1, 0, 1 })
 	{
 		for (int dx : { -1, 0, 1 })
 		{
-			mnist::ImageData out_image = image;
+			mnist::ImageData<T> out_image = image;
 
-			const auto crpix = [](const mnist::ImageData& image, int x, int y) -> const mnist::ImageData::value_type& { return image[y * mnist::ImageWidth + x]; };
-			const auto rpix = [](mnist::ImageData& image, int x, int y) -> mnist::ImageData::value_type& { return image[y * mnist::ImageWidth + x]; };
+			const auto crpix = [](const mnist::ImageData<T>& image, int x, int y) -> const T& { return image[y * mnist::ImageWidth + x]; };
+			const auto rpix = [](mnist::ImageData<T>& image, int x, int y) -> T& { return image[y * mnist::ImageWidth + x]; };
 
 			for (int y = 1; y < mnist::ImageHeight - 1; y++)
 			{
@@ -39,8 +62,23 @@ std::vector<mnist::ImageData> mutate(const mnist::ImageData& image)
 	return out;
 }
 
-template <typename NetworkType>
-std::pair<std::size_t, std::size_t> results(NetworkType& n, const std::vector<std::vector<double>>& input, const std::vector<int>& labels)
+template <typename T>
+std::vector<mnist::ImageData<T>> mutate(const DatasetView& view, std::size_t i)
+{
+	std::vector<mnist::ImageData<T>> image;
+	view.assemble(i, 1, image);
+	return mutate(image.front());
+}
+
+template <typename T>
+std::pair<std::size_t, std::size_t> results(Network<T>& n, const std::vector<std::vector<T>>& input, const std::vector<int>& labels)
+{
+	const auto evaluation = evaluate(Model<T>(n), input, labels);
+	return { evaluation.correct, evaluation.total };
+}
+
+template <typename NetworkType, typename T>
+std::pair<std::size_t, std::size_t> results(NetworkType& n, const std::vector<std::vector<T>>& input, const std::vector<int>& labels)
 {
 	std::size_t correct {};
 	for (std::size_t d{}; d < input.size(); ++d)
@@ -57,59 +95,493 @@ std::pair<std::size_t, std::size_t> results(NetworkType& n, const std::vector<st
 	return { correct, input.size() };
 }
 
-//template <typename NetworkType>
-void run_network(Network& n)
+template <typename T>
+std::pair<std::size_t, std::size_t> results(Network<T>& n, const DatasetView& view)
+{
+	const auto evaluation = evaluate(Model<T>(n), view);
+	return { evaluation.correct, evaluation.total };
+}
+
+template <typename NetworkType>
+std::pair<std::size_t, std::size_t> results(NetworkType& n, const DatasetView& view)
+{
+	std::vector<std::vector<typename NetworkType::value_type>> image;
+	std::size_t correct {};
+	for (std::size_t d{}; d < view.size(); ++d)
+	{
+		view.assemble(d, 1, image);
+		if (util::argmax(n.feedForward(image.front())) == view.label(d))
+		{
+			correct++;
+		}
+	}
+
+	return { correct, view.size() };
+}
+
+// Single-threaded samples per second, measured on a copy of the network.
+template <typename T>
+double single_thread_throughput(const Network<T>& n, const DatasetView& data)
 {
-	auto data = mnist::readTrainingData("d:/dev/cpp/handreco-data/");
-//	auto data = mnist::custom::readImagesMatching("d:/dev/cpp/handreco-data", "?__*.*");
+	static const std::size_t CALIBRATION_SAMPLES = 5000;
 
-	static const std::size_t LEARNING_SAMPLES = 50000;
+	auto probe = n;
+	const std::size_t batch_size = probe.miniBatchSize();
+	const std::size_t samples = std::min(CALIBRATION_SAMPLES, data.size());
+	std::vector<std::vector<T>> batch;
+	std::vector<int> labels;
 
-	const auto learning_data = mnist::ImagesData(data.images.begin(), data.images.begin() + LEARNING_SAMPLES);
-	const auto learning_labels = mnist::Labels(data.labels.begin(), data.labels.begin() + LEARNING_SAMPLES);
+	auto before = std::chrono::high_resolution_clock::now();
+	for (std::size_t i {}; i < samples; i += batch_size)
+	{
+		data.assemble(i, std::min(batch_size, samples - i), batch, labels);
+		probe.learnBatch(batch, labels);
+	}
+	auto after = std::chrono::high_resolution_clock::now();
 
-	const auto verification_data = mnist::ImagesData(data.images.begin() + LEARNING_SAMPLES, data.images.end());
-	const auto verification_labels = mnist::Labels(data.labels.begin() + LEARNING_SAMPLES, data.labels.end());
+	return samples / std::chrono::duration<double>(after - before).count();
+}
 
-//	std::cout << "before: " << results(n, verification_data, verification_labels).first << std::endl;
+struct TrainingOptions
+{
+	std::size_t threads = ThreadPool::global().concurrency();
+	TrainingMode mode = TrainingMode::Synchronous;
+	// verification accuracy at which TrainingReport::secondsToTarget is taken
+	double targetAccuracy = 0;
+	// resumed from if it exists, written every few epochs or seconds and removed
+	// once the last epoch is done, unless empty
+	std::string checkpoint {};
+	int checkpointEpochs = 1;
+	double checkpointSeconds = 0;
+};
 
-	for (int epoch {}; epoch < 30; epoch++)
+inline void print_confusion(const Evaluation& evaluation)
+{
+	std::cout << "expected \\ predicted" << std::endl << "    ";
+	for (std::size_t predicted {}; predicted < evaluation.classes; predicted++)
+	{
+		std::cout << std::setw(6) << predicted;
+	}
+	std::cout << std::endl;
+	for (std::size_t expected {}; expected < evaluation.classes; expected++)
 	{
+		std::cout << std::setw(4) << expected;
+		for (std::size_t predicted {}; predicted < evaluation.classes; predicted++)
+		{
+			std::cout << std::setw(6) << evaluation.count(expected, predicted);
+		}
+		std::cout << std::endl;
+	}
+}
 
-		auto before = std::chrono::high_resolution_clock::now();
-		for (std::size_t i {}; i < learning_data.size(); i++)
+struct TrainingReport
+{
+	// on the verification data after the last epoch
+	Evaluation evaluation {};
+	double samplesPerSecond {};
+	// training time (evaluation excluded) until the target accuracy, negative if never reached
+	double secondsToTarget = -1;
+};
+
+template <typename T>
+TrainingReport train_network(Network<T>& n, const DatasetView& learning_data, const DatasetView& verification_data, int epochs,
+							 const TrainingOptions& options = {})
+{
+	const std::size_t threads = options.threads;
+	const double single_thread = threads > 1 ? single_thread_throughput(n, learning_data) : 0;
+	const std::size_t chunk_size = std::max<std::size_t>(TRAINING_CHUNK / n.miniBatchSize(), 1) * n.miniBatchSize();
+
+	ParallelTrainer<T> trainer(n, threads, options.mode);
+
+	std::cout << "kernels: " << kernels::isaName(kernels::activeIsa()) << ", threads: " << threads
+			  << (options.mode == TrainingMode::Hogwild ? ", hogwild" : "") << std::endl;
+//	std::cout << "before: " << results(n, verification_data).first << std::endl;
+
+	int first_epoch {};
+	std::optional<Checkpointer<T>> checkpointer;
+	if (!options.checkpoint.empty())
+	{
+		first_epoch = Checkpointer<T>::resume(options.checkpoint, n);
+		if (first_epoch > 0)
 		{
+			std::cout << "resumed from " << options.checkpoint << " after epoch " << first_epoch << std::endl;
+		}
+		checkpointer.emplace(options.checkpoint, options.checkpointEpochs, options.checkpointSeconds);
+	}
 
-			const auto& label = util::vectorized<mnist::Data::Outputs>(learning_labels[i]);
-			const auto& image = learning_data[i];
-			n.learnOnce(image, label);
+	// Hogwild shuffles within a chunk, so the chunks get samples from all over
+	PipelineOptions<T> pipeline_options;
+	pipeline_options.shuffle = options.mode == TrainingMode::Hogwild;
+	pipeline_options.seed = unsigned(first_epoch);
+	BatchPipeline<T> pipeline(learning_data, chunk_size, pipeline_options);
 
+	TrainingReport report;
+	double training_seconds {};
+	for (int epoch = first_epoch; epoch < epochs; epoch++)
+	{
+		auto before = std::chrono::high_resolution_clock::now();
+		for (const auto& chunk : pipeline.epoch())
+		{
+			trainer.learnEpoch(chunk.inputs, chunk.labels);
 		}
 		auto after = std::chrono::high_resolution_clock::now();
+		if (checkpointer)
+		{
+			checkpointer->update(n, epoch + 1);
+		}
+		const double epoch_seconds = std::chrono::duration<double>(after - before).count();
+		training_seconds += epoch_seconds;
+
+		const auto evaluation_start = std::chrono::high_resolution_clock::now();
+		report.evaluation = evaluate(Model<T>(n), verification_data);
+		const auto evaluation_end = std::chrono::high_resolution_clock::now();
+		if (report.secondsToTarget < 0 && options.targetAccuracy > 0 && report.evaluation.accuracy() >= options.targetAccuracy)
+		{
+			report.secondsToTarget = training_seconds;
+		}
+		const double samples_per_second = learning_data.size() / epoch_seconds;
+		std::cout << "epoch " << epoch + 1 << ": " << report.evaluation.correct
+				  << " after " << std::chrono::duration_cast<std::chrono::milliseconds>(after - before).count() << " ms, "
+				  << std::fixed << std::setprecision(0) << samples_per_second << " samples/s on " << threads << " threads";
+		if (single_thread > 0)
+		{
+			std::cout << " (" << std::setprecision(2) << samples_per_second / single_thread << "x)";
+		}
+		std::cout << ", evaluated in " << std::chrono::duration_cast<std::chrono::milliseconds>(evaluation_end - evaluation_start).count() << " ms"
+				  << std::defaultfloat << std::endl;
+	}
+	if (first_epoch >= epochs)
+	{
+		// resumed after the last epoch, the report still describes the network
+		report.evaluation = evaluate(Model<T>(n), verification_data);
+	}
+	if (checkpointer)
+	{
+		// the next run starts over instead of resuming a finished training
+		checkpointer->wait();
+		checkpointer.reset();
+		std::remove(options.checkpoint.c_str());
+	}
+	if (training_seconds > 0)
+	{
+		report.samplesPerSecond = (epochs - first_epoch) * learning_data.size() / training_seconds;
+	}
+
+	return report;
+}
 
-		std::cout << "epoch " << epoch + 1 << ": " << results(n, verification_data, verification_labels).first
-				  << " after " << std::chrono::duration_cast<std::chrono::milliseconds>(after - before).count() << " ms" << std::endl;
+// Accuracy, weight memory and throughput of the int8 model, calibrated on the
+// verification data, against the model it was quantized from.
+template <typename T>
+void print_quantization_report(const Model<T>& model, util::span<const mnist::ImageData<T>> images, util::span<const int> labels)
+{
+	const QuantizedModel quantized(model, images);
+
+	std::size_t model_bytes {};
+	for (const auto& layer : model.layers())
+	{
+		model_bytes += layer.weights.size() * sizeof(T);
 	}
 
-	auto own = mnist::custom::readImagesMatching("d:/dev/cpp/handreco-data", "?__*.*");
+	const auto before = std::chrono::high_resolution_clock::now();
+	const auto expected = evaluate(model, images, labels);
+	const auto middle = std::chrono::high_resolution_clock::now();
+	const auto result = evaluate<T>(quantized, images, labels);
+	const auto after = std::chrono::high_resolution_clock::now();
+
+	const auto print = [&](const char* name, const Evaluation& evaluation, std::size_t bytes, double seconds)
+	{
+		std::cout << std::setw(10) << name
+				  << std::setw(10) << std::fixed << std::setprecision(2) << 100. * evaluation.accuracy() << " %"
+				  << std::setw(10) << bytes / 1024 << " KiB weights"
+				  << std::setw(12) << std::setprecision(0) << evaluation.total / seconds << " samples/s" << std::endl;
+	};
+	std::cout << "int8 dot products: " << (kernels::usesVnni() ? "avx512 vnni" : kernels::isaName(kernels::activeIsa())) << std::endl;
+	print(sizeof(T) == sizeof(float) ? "float" : "double", expected, model_bytes, std::chrono::duration<double>(middle - before).count());
+	print("int8", result, quantized.weightBytes(), std::chrono::duration<double>(after - middle).count());
+	std::cout << "accuracy loss: " << std::setprecision(2) << 100. * (expected.accuracy() - result.accuracy()) << " points"
+			  << std::defaultfloat << std::endl;
+}
+
+template <typename T>
+Network<T> make_mnist_network()
+{
+	static const std::size_t HIDDEN_UNITS = 60;
+	static const T LEARNING_FACTOR = T(0.06);
+	static const std::size_t BATCH_SIZE = 10;
+	return Network<T>({mnist::Data<T>::Inputs, HIDDEN_UNITS, mnist::Data<T>::Outputs},
+					  Activation::LeakyRelu, LEARNING_FACTOR, BATCH_SIZE);
+}
+
+template <typename T>
+void run_network(Network<T>& n)
+{
+	const auto [learning, verification] = DatasetView(mnist::readTrainingSet(DATA_DIRECTORY)).split(LEARNING_SAMPLES);
+
+	TrainingOptions options;
+	options.checkpoint = CHECKPOINT_FILE;
+	const auto report = train_network<T>(n, learning, verification, 30, options);
+	print_confusion(report.evaluation);
+
+	const Model<T> model(n);
+	model.save(MODEL_FILE);
+	std::cout << "saved to " << MODEL_FILE << std::endl;
+	exportHeader(model, MODEL_HEADER, "mnist_model");
+	std::cout << "exported to " << MODEL_HEADER << std::endl;
+
+	// the int8 model is calibrated on normalized images
+	mnist::ImagesData<T> verification_images;
+	mnist::Labels verification_labels;
+	verification.assemble(0, verification.size(), verification_images, verification_labels);
+	print_quantization_report<T>(model, verification_images, verification_labels);
+
+	auto own = mnist::custom::readImagesMatching<T>(DATA_DIRECTORY, "?__*.*");
 	auto own_results = results(n, own.images, own.labels);
 	std::cout << "own images: " << own_results.first << "/" << own_results.second << std::endl;
 }
 
 void run_dynamic_network()
 {
-	static const std::size_t HIDDEN_UNITS = 60;
-	static const double LEARNING_FACTOR = 0.06;
-	static const std::size_t BATCH_SIZE = 10;
-	Network n({mnist::Data::Inputs, HIDDEN_UNITS, mnist::Data::Outputs},
-			  util::leakyRelu, util::leakyReluPrime, LEARNING_FACTOR, BATCH_SIZE);
+	auto n = make_mnist_network<double>();
 
 	run_network(n);
 }
 
+// Evaluates the model saved by run_network without training.
+void run_saved_model()
+{
+	const auto before = std::chrono::high_resolution_clock::now();
+	const auto model = Model<double>::load(MODEL_FILE);
+	const auto after = std::chrono::high_resolution_clock::now();
+	std::cout << "loaded " << MODEL_FILE << " in " << std::chrono::duration<double, std::milli>(after - before).count() << " ms" << std::endl;
+
+	const auto verification = DatasetView(mnist::readTrainingSet(DATA_DIRECTORY)).split(LEARNING_SAMPLES).second;
+	const auto evaluation = evaluate(model, verification);
+	std::cout << evaluation.correct << "/" << evaluation.total << std::endl;
+
+	// the int8 model is calibrated on normalized images
+	mnist::ImagesData<double> verification_images;
+	mnist::Labels verification_labels;
+	verification.assemble(0, verification.size(), verification_images, verification_labels);
+	print_quantization_report<double>(model, verification_images, verification_labels);
+}
+
+template <typename T>
+TrainingReport run_precision(int epochs)
+{
+	auto n = make_mnist_network<T>();
+	const auto [learning, verification] = DatasetView(mnist::readTrainingSet(DATA_DIRECTORY)).split(LEARNING_SAMPLES);
+	return train_network<T>(n, learning, verification, epochs);
+}
+
+// Trains the same architecture with float and double parameters and compares throughput and accuracy.
+void run_precision_comparison()
+{
+	static const int EPOCHS = 10;
+
+	std::cout << "double:" << std::endl;
+	const auto double_report = run_precision<double>(EPOCHS);
+	std::cout << "float:" << std::endl;
+	const auto float_report = run_precision<float>(EPOCHS);
+
+	const auto print = [](const char* name, const TrainingReport& report)
+	{
+		std::cout << std::setw(8) << name
+				  << std::setw(14) << std::fixed << std::setprecision(0) << report.samplesPerSecond << " samples/s"
+				  << std::setw(10) << std::setprecision(2) << 100. * report.evaluation.accuracy() << " % accuracy" << std::endl;
+	};
+	print("double", double_report);
+	print("float", float_report);
+	std::cout << "float speed-up: " << std::setprecision(2) << float_report.samplesPerSecond / double_report.samplesPerSecond << "x" << std::endl;
+}
+
+// Time-to-accuracy of lock-free Hogwild training against synchronous training
+// on a single thread (what run_network used to do) and on all threads.
+void run_hogwild_benchmark()
+{
+	static const int EPOCHS = 10;
+	static const double TARGET_ACCURACY = 0.95;
+
+	const auto [learning, verification] = DatasetView(mnist::readTrainingSet(DATA_DIRECTORY)).split(LEARNING_SAMPLES);
+	const auto initial = make_mnist_network<double>();
+	const std::size_t threads = ThreadPool::global().concurrency();
+
+	struct Run
+	{
+		const char* name;
+		TrainingOptions options;
+	};
+	const Run runs[] {
+		{ "single thread", { 1, TrainingMode::Synchronous, TARGET_ACCURACY } },
+		{ "synchronous", { threads, TrainingMode::Synchronous, TARGET_ACCURACY } },
+		{ "hogwild", { threads, TrainingMode::Hogwild, TARGET_ACCURACY } },
+	};
+
+	std::vector<TrainingReport> reports;
+	for (const auto& run : runs)
+	{
+		std::cout << run.name << ":" << std::endl;
+		auto n = initial;
+		reports.push_back(train_network<double>(n, learning, verification, EPOCHS, run.options));
+	}
+
+	std::cout << "time to " << std::setprecision(0) << std::fixed << 100 * TARGET_ACCURACY << " % accuracy:" << std::endl;
+	for (std::size_t i {}; i < reports.size(); i++)
+	{
+		std::cout << std::setw(14) << runs[i].name << std::setw(4) << runs[i].options.threads << " threads";
+		if (reports[i].secondsToTarget < 0)
+		{
+			std::cout << "      not reached";
+		}
+		else
+		{
+			std::cout << std::setw(10) << std::setprecision(2) << reports[i].secondsToTarget << " s";
+		}
+		std::cout << std::setw(10) << std::setprecision(2) << 100. * reports[i].evaluation.accuracy() << " % final" << std::endl;
+	}
+}
+
+// Samples per second of classify() one sample at a time on the calling thread.
+template <typename ModelType, typename T>
+double classification_throughput(const ModelType& model, util::span<const mnist::ImageData<T>> images)
+{
+	InferenceContext<T> context;
+	std::size_t checksum {};
+	const auto before = std::chrono::high_resolution_clock::now();
+	for (const auto& image : images)
+	{
+		checksum += model.classify(image, context);
+	}
+	const auto after = std::chrono::high_resolution_clock::now();
+	// keeps the loop from being optimised away
+	if (checksum == std::size_t(-1))
+	{
+		std::cout << checksum;
+	}
+	return images.size() / std::chrono::duration<double>(after - before).count();
+}
+
+// Prunes a trained network to 50, 80 and 95 % sparsity, fine-tunes it with the
+// mask fixed and compares single-threaded sparse inference against dense
+// inference: single weights pruned and run as CSR, whole cache lines pruned
+// and run as blocks.
+void run_pruning_benchmark()
+{
+	static const int EPOCHS = 10;
+	static const int FINE_TUNING_EPOCHS = 3;
+	using T = float;
+
+	auto trained = make_mnist_network<T>();
+	const auto [learning, verification] = DatasetView(mnist::readTrainingSet(DATA_DIRECTORY)).split(LEARNING_SAMPLES);
+	train_network<T>(trained, learning, verification, EPOCHS);
+
+	// inference is timed without the normalization
+	mnist::ImagesData<T> normalized;
+	verification.assemble(0, verification.size(), normalized);
+	const util::span<const mnist::ImageData<T>> verification_images(normalized);
+
+	const Model<T> dense(trained);
+	std::size_t dense_bytes {};
+	for (const auto& layer : dense.layers())
+	{
+		dense_bytes += layer.weights.size() * sizeof(T);
+	}
+	const double dense_throughput = classification_throughput(dense, verification_images);
+
+	const auto print = [&](const std::string& name, const Evaluation& evaluation, std::size_t bytes, double throughput)
+	{
+		std::cout << std::setw(16) << name
+				  << std::setw(10) << std::fixed << std::setprecision(2) << 100. * evaluation.accuracy() << " %"
+				  << std::setw(8) << bytes / 1024 << " KiB"
+				  << std::setw(12) << std::setprecision(0) << throughput << " samples/s"
+				  << std::setw(8) << std::setprecision(2) << throughput / dense_throughput << "x" << std::defaultfloat << std::endl;
+	};
+	std::cout << "single-threaded inference, " << kernels::isaName(kernels::activeIsa()) << ":" << std::endl;
+	print("dense", evaluate(dense, verification), dense_bytes, dense_throughput);
+
+	using Format = SparseModel<T>::Format;
+	for (double sparsity : { 0.5, 0.8, 0.95 })
+	{
+		for (auto format : { Format::Csr, Format::Blocked })
+		{
+			auto pruned = trained;
+			const PruningMask<T> mask(pruned, sparsity, format == Format::Csr ? 1 : kernels::SparseBlock<T>);
+			fineTune(pruned, mask, learning, FINE_TUNING_EPOCHS);
+
+			const SparseModel<T> sparse(Model<T>(pruned), format);
+			const std::string name = std::to_string(int(100 * sparsity + 0.5)) + (format == Format::Csr ? " % csr" : " % blocked");
+			print(name, evaluate(sparse, verification), sparse.weightBytes(),
+				  classification_throughput(sparse, verification_images));
+		}
+	}
+}
+
+// The 30-epoch MNIST run of run_network with make_mnist_network's shape and
+// hyperparameters, trained in the same mini-batches on one thread by the
+// StaticNetwork and by the Network.
 void run_static_network()
 {
-//	StaticNetwork<784, 50, 10, &util::leakyRelu, &util::leakyReluPrime, 3> n;
+	static const int EPOCHS = 30;
+	using T = double;
+	using Static = StaticNetwork<T, &util::leakyRelu, &util::leakyReluPrime, mnist::Data<T>::Inputs, 60, mnist::Data<T>::Outputs>;
+
+	const auto sets = DatasetView(mnist::readTrainingSet(DATA_DIRECTORY)).split(LEARNING_SAMPLES);
+	const DatasetView& learning = sets.first;
+	const DatasetView& verification = sets.second;
+
+	auto n = make_mnist_network<T>();
+	Static s(T(0.06), n.miniBatchSize());
+	const std::size_t batch_size = n.miniBatchSize();
+	const std::size_t chunk_size = std::max<std::size_t>(TRAINING_CHUNK / batch_size, 1) * batch_size;
+
+	const auto train = [&](const char* name, auto& network, auto classify)
+	{
+		std::cout << name << ":" << std::endl;
+		BatchPipeline<T> learning_chunks(learning, chunk_size);
+		BatchPipeline<T> verification_chunks(verification, chunk_size);
+		double seconds {};
+		std::size_t correct {};
+		for (int epoch {}; epoch < EPOCHS; epoch++)
+		{
+			const auto before = std::chrono::high_resolution_clock::now();
+			for (const auto& chunk : learning_chunks.epoch())
+			{
+				const util::span<const mnist::ImageData<T>> images(chunk.inputs);
+				const util::span<const int> labels(chunk.labels);
+				for (std::size_t i {}; i < images.size(); i += batch_size)
+				{
+					const std::size_t count = std::min(batch_size, images.size() - i);
+					network.learnBatch(images.subspan(i, count), labels.subspan(i, count));
+				}
+			}
+			const auto after = std::chrono::high_resolution_clock::now();
+			seconds += std::chrono::duration<double>(after - before).count();
 
-//	run_network(n);
+			correct = 0;
+			for (const auto& chunk : verification_chunks.epoch())
+			{
+				for (std::size_t i {}; i < chunk.inputs.size(); i++)
+				{
+					correct += classify(chunk.inputs[i]) == chunk.labels[i];
+				}
+			}
+			std::cout << "epoch " << epoch + 1 << ": " << correct << " after "
+					  << std::chrono::duration_cast<std::chrono::milliseconds>(after - before).count() << " ms" << std::endl;
+		}
+		return std::make_pair(EPOCHS * learning.size() / seconds, double(correct) / verification.size());
+	};
+
+	const auto static_result = train("static", s, [&](const auto& image) { return s.classify(image); });
+	const auto dynamic_result = train("dynamic", n, [&](const auto& image) { return n.classify(image); });
+
+	const auto print = [](const char* name, std::pair<double, double> result)
+	{
+		std::cout << std::setw(8) << name
+				  << std::setw(12) << std::fixed << std::setprecision(0) << result.first << " samples/s"
+				  << std::setw(10) << std::setprecision(2) << 100. * result.second << " % accuracy" << std::defaultfloat << std::endl;
+	};
+	std::cout << EPOCHS << " epochs on one thread, " << kernels::isaName(kernels::activeIsa()) << ":" << std::endl;
+	print("static", static_result);
+	print("dynamic", dynamic_result);
+	std::cout << "static speed-up: " << std::setprecision(2) << static_result.first / dynamic_result.first << "x" << std::endl;
 }
@@ -0,0 +1,151 @@
+#include "parallel_trainer.h"
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// the targets are sliced like the inputs before the network sees them
+	void checkTargetCount(std::size_t inputs, std::size_t targets)
+	{
+		if (inputs != targets)
+		{
+			throw std::invalid_argument("Training on " + std::to_string(inputs) + " inputs with " + std::to_string(targets) + " targets");
+		}
+	}
+}
+
+
+template <typename T>
+ParallelTrainer<T>::ParallelTrainer(Network<T>& network, std::size_t threads, TrainingMode mode, ThreadPool& pool)
+	: network(network)
+	, pool(pool)
+	, shares(std::max<std::size_t>(threads, 1))
+	, trainingMode(mode)
+{
+	for (auto& share : shares)
+	{
+		share.corrections = network.makeCorrections();
+	}
+}
+
+template <typename T>
+void ParallelTrainer<T>::learnEpoch(util::span<const std::vector<T>> inputs, util::span<const std::vector<T>> expected)
+{
+	runEpoch(inputs, Targets { expected, {} });
+}
+
+template <typename T>
+void ParallelTrainer<T>::learnEpoch(util::span<const std::vector<T>> inputs, util::span<const int> labels)
+{
+	runEpoch(inputs, Targets { {}, labels });
+}
+
+template <typename T>
+void ParallelTrainer<T>::learnBatch(util::span<const std::vector<T>> inputs, util::span<const std::vector<T>> expected)
+{
+	runBatch(inputs, Targets { expected, {} });
+}
+
+template <typename T>
+void ParallelTrainer<T>::learnBatch(util::span<const std::vector<T>> inputs, util::span<const int> labels)
+{
+	runBatch(inputs, Targets { {}, labels });
+}
+
+template <typename T>
+void ParallelTrainer<T>::runEpoch(util::span<const std::vector<T>> inputs, const Targets& expected)
+{
+	checkTargetCount(inputs.size(), expected.size());
+	if (trainingMode == TrainingMode::Synchronous)
+	{
+		const std::size_t batch_size = network.miniBatchSize();
+		for (std::size_t i {}; i < inputs.size(); i += batch_size)
+		{
+			const std::size_t samples = std::min(batch_size, inputs.size() - i);
+			runBatch(inputs.subspan(i, samples), expected.subspan(i, samples));
+		}
+		return;
+	}
+
+	order.resize(inputs.size());
+	std::iota(order.begin(), order.end(), std::size_t {});
+	std::shuffle(order.begin(), order.end(), engine);
+
+	// the only synchronisation: the epoch ends when every slice is done
+	const std::size_t count = shares.size();
+	parallel_for(0, count, 1, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t index = first; index < last; index++)
+		{
+			auto& workspace = shares[index].workspace;
+			for (std::size_t i = order.size() * index / count; i < order.size() * (index + 1) / count; i++)
+			{
+				network.learnOnceUnsynchronized(inputs[order[i]], expected, order[i], workspace);
+			}
+		}
+	}, pool);
+}
+
+template <typename T>
+void ParallelTrainer<T>::runBatch(util::span<const std::vector<T>> inputs, const Targets& expected)
+{
+	checkTargetCount(inputs.size(), expected.size());
+	const std::size_t samples = inputs.size();
+	if (samples == 0)
+	{
+		return;
+	}
+
+	const std::size_t count = shares.size();
+	parallel_for(0, count, 1, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t index = first; index < last; index++)
+		{
+			const std::size_t begin = samples * index / count;
+			const std::size_t end = samples * (index + 1) / count;
+			network.accumulateGradients(inputs.subspan(begin, end - begin), expected.subspan(begin, end - begin),
+										shares[index].workspace, shares[index].corrections.layers);
+		}
+	}, pool);
+
+	// log2(count) rounds, in each one half of the remaining copies are added
+	// into the other half; share 0 ends up with the sum
+	for (std::size_t stride = 1; stride < count; stride *= 2)
+	{
+		const std::size_t pairs = (count - stride + 2 * stride - 1) / (2 * stride);
+		parallel_for(0, pairs, 1, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t pair = first; pair < last; pair++)
+			{
+				const std::size_t index = pair * 2 * stride;
+				reduce(shares[index].corrections.layers, shares[index + stride].corrections.layers);
+			}
+		}, pool);
+	}
+
+	network.applyGradients(shares[0].corrections.layers, samples);
+}
+
+template <typename T>
+void ParallelTrainer<T>::reduce(std::vector<typename Network<T>::LayerCorrection>& target, std::vector<typename Network<T>::LayerCorrection>& source)
+{
+	for (std::size_t layer = 1; layer < source.size(); layer++)
+	{
+		auto& from = source[layer];
+		auto& to = target[layer];
+
+		kernels::axpy(from.weights.size(), T{1}, from.weights.data(), to.weights.data());
+		kernels::axpy(from.biases.size(), T{1}, from.biases.data(), to.biases.data());
+
+		std::fill(from.weights.begin(), from.weights.end(), T{});
+		std::fill(from.biases.begin(), from.biases.end(), T{});
+	}
+}
+
+template class ParallelTrainer<float>;
+template class ParallelTrainer<double>;
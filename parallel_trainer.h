@@ -0,0 +1,73 @@
+#pragma once
+
+#include "network.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+
+enum class TrainingMode { Synchronous, Hogwild };
+
+
+// Data-parallel training of one Network on the thread pool. The work is cut
+// into `threads` shares, each with its own workspace and corrections.
+//
+// Synchronous: every mini-batch is split between the shares, each
+// accumulates the gradients of its samples into its own corrections, the
+// copies are summed by a parallel tree reduction and the network is updated
+// once per mini-batch.
+//
+// Hogwild: each share runs learnOnce over its own slice of the shuffled
+// epoch and writes the updates into the shared weights without any locks.
+template <typename T>
+class ParallelTrainer
+{
+public:
+
+	explicit ParallelTrainer(Network<T>& network,
+							 std::size_t threads = ThreadPool::global().concurrency(),
+							 TrainingMode mode = TrainingMode::Synchronous,
+							 ThreadPool& pool = ThreadPool::global());
+
+	std::size_t threadCount() const { return shares.size(); }
+	TrainingMode mode() const { return trainingMode; }
+
+	// One pass over the samples: consecutive mini-batches of the network's
+	// batch size when synchronous, a shuffled order when Hogwild. Labels are
+	// class indices of one-hot targets. Both throw std::invalid_argument unless
+	// there is a target for every input.
+	void learnEpoch(util::span<const std::vector<T>> inputs, util::span<const std::vector<T>> expected);
+	void learnEpoch(util::span<const std::vector<T>> inputs, util::span<const int> labels);
+
+	// Same update as Network::learnBatch, up to the order of summation.
+	void learnBatch(util::span<const std::vector<T>> inputs, util::span<const std::vector<T>> expected);
+	void learnBatch(util::span<const std::vector<T>> inputs, util::span<const int> labels);
+
+private:
+
+	using Targets = typename Network<T>::Targets;
+
+	void runEpoch(util::span<const std::vector<T>> inputs, const Targets& expected);
+	void runBatch(util::span<const std::vector<T>> inputs, const Targets& expected);
+
+	struct Share {
+		typename Network<T>::BatchWorkspace workspace {};
+		typename Network<T>::OwnedCorrections corrections {};
+	};
+
+	// target += source, source = 0
+	static void reduce(std::vector<typename Network<T>::LayerCorrection>& target, std::vector<typename Network<T>::LayerCorrection>& source);
+
+	Network<T>& network;
+	ThreadPool& pool;
+	std::vector<Share> shares {};
+
+	TrainingMode trainingMode {};
+	std::vector<std::size_t> order {};
+	std::default_random_engine engine { std::random_device{}() };
+};
+
+extern template class ParallelTrainer<float>;
+extern template class ParallelTrainer<double>;
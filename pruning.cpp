@@ -0,0 +1,140 @@
+#include "pruning.h"
+
+#include "batch_pipeline.h"
+#include "kernels.h"
+#include "parallel_trainer.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+template <typename T>
+PruningMask<T>::PruningMask(const Network<T>& network, double sparsity, std::size_t group)
+{
+	group = std::max<std::size_t>(group, 1);
+
+	struct Group
+	{
+		std::size_t layer;
+		std::size_t begin;
+		std::size_t end;
+		T magnitude;
+	};
+	std::vector<Group> groups;
+	std::size_t weights {};
+
+	keep.resize(network.layers.size());
+	for (std::size_t layer = 1; layer < network.layers.size(); layer++)
+	{
+		const auto& current_layer = network.layers[layer];
+		const std::size_t inputs = current_layer.previousSize;
+		keep[layer].assign(current_layer.weights.size(), T{1});
+		weights += current_layer.weights.size();
+
+		for (std::size_t n {}; n < current_layer.size(); n++)
+		{
+			for (std::size_t c {}; c < inputs; c += group)
+			{
+				const std::size_t begin = n * inputs + c;
+				const std::size_t end = n * inputs + std::min(c + group, inputs);
+				T magnitude {};
+				for (std::size_t i = begin; i < end; i++)
+				{
+					magnitude += std::abs(current_layer.weights[i]);
+				}
+				groups.push_back({ layer, begin, end, magnitude / T(end - begin) });
+			}
+		}
+	}
+
+	// prune the smallest groups until the pruned weights reach the target
+	std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) { return a.magnitude < b.magnitude; });
+	const std::size_t target = std::size_t(std::clamp(sparsity, 0., 1.) * weights + 0.5);
+	std::size_t pruned {};
+	for (std::size_t g {}; g < groups.size() && pruned + (groups[g].end - groups[g].begin) <= target; g++)
+	{
+		std::fill(keep[groups[g].layer].begin() + groups[g].begin, keep[groups[g].layer].begin() + groups[g].end, T{});
+		pruned += groups[g].end - groups[g].begin;
+	}
+}
+
+template <typename T>
+void PruningMask<T>::apply(Network<T>& network) const
+{
+	for (std::size_t layer = 1; layer < network.layers.size(); layer++)
+	{
+		auto& weights = network.layers[layer].weights;
+		kernels::multiply(weights.size(), keep[layer].data(), weights.data());
+	}
+}
+
+template <typename T>
+double PruningMask<T>::sparsity() const
+{
+	std::size_t weights {};
+	std::size_t pruned {};
+	for (const auto& layer : keep)
+	{
+		weights += layer.size();
+		pruned += std::count(layer.begin(), layer.end(), T{});
+	}
+	return weights ? double(pruned) / weights : 0.;
+}
+
+
+namespace
+{
+	// samples normalized at a time by fineTune on a view, rounded down to whole mini-batches
+	const std::size_t FineTuningChunk = 1000;
+
+	template <typename T>
+	void learnMasked(ParallelTrainer<T>& trainer, Network<T>& network, const PruningMask<T>& mask,
+					 util::span<const std::vector<T>> inputs, util::span<const int> labels)
+	{
+		const std::size_t batch_size = network.miniBatchSize();
+		for (std::size_t i {}; i < inputs.size(); i += batch_size)
+		{
+			const std::size_t samples = std::min(batch_size, inputs.size() - i);
+			trainer.learnBatch(inputs.subspan(i, samples), labels.subspan(i, samples));
+			mask.apply(network);
+		}
+	}
+}
+
+template <typename T>
+void fineTune(Network<T>& network, const PruningMask<T>& mask,
+			  util::nondeduced_t<util::span<const std::vector<T>>> inputs, util::span<const int> labels, int epochs,
+			  std::size_t threads)
+{
+	ParallelTrainer<T> trainer(network, threads);
+
+	mask.apply(network);
+	for (int epoch {}; epoch < epochs; epoch++)
+	{
+		learnMasked(trainer, network, mask, inputs, labels);
+	}
+}
+
+template <typename T>
+void fineTune(Network<T>& network, const PruningMask<T>& mask, const DatasetView& samples, int epochs, std::size_t threads)
+{
+	ParallelTrainer<T> trainer(network, threads);
+	const std::size_t batch_size = network.miniBatchSize();
+	BatchPipeline<T> pipeline(samples, std::max<std::size_t>(FineTuningChunk / batch_size, 1) * batch_size);
+
+	mask.apply(network);
+	for (int epoch {}; epoch < epochs; epoch++)
+	{
+		for (const auto& chunk : pipeline.epoch())
+		{
+			learnMasked<T>(trainer, network, mask, chunk.inputs, chunk.labels);
+		}
+	}
+}
+
+template class PruningMask<float>;
+template class PruningMask<double>;
+template void fineTune<float>(Network<float>&, const PruningMask<float>&, util::span<const std::vector<float>>, util::span<const int>, int, std::size_t);
+template void fineTune<double>(Network<double>&, const PruningMask<double>&, util::span<const std::vector<double>>, util::span<const int>, int, std::size_t);
+template void fineTune<float>(Network<float>&, const PruningMask<float>&, const DatasetView&, int, std::size_t);
+template void fineTune<double>(Network<double>&, const PruningMask<double>&, const DatasetView&, int, std::size_t);
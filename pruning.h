@@ -0,0 +1,53 @@
+#pragma once
+
+#include "dataset.h"
+#include "network.h"
+#include "thread_pool.h"
+
+#include <vector>
+
+
+// The weights of a network that survive magnitude pruning, fixed once chosen.
+// Biases are never pruned.
+template <typename T>
+class PruningMask
+{
+public:
+
+	// Prunes the given fraction of all weights, the smallest first, ranked
+	// across layers so the wide input layer gives up more than the small ones.
+	// Weights are ranked and kept in groups of `group` consecutive weights of
+	// a row, by their mean magnitude; kernels::SparseBlock<T> makes whole
+	// blocks of SparseModel's blocked format.
+	PruningMask(const Network<T>& network, double sparsity, std::size_t group = 1);
+
+	// Zeroes the pruned weights.
+	void apply(Network<T>& network) const;
+	// Fraction of the weights pruned.
+	double sparsity() const;
+
+private:
+
+	// per layer 1 for a kept weight and 0 for a pruned one, so apply() is a multiplication
+	std::vector<util::AlignedVector<T>> keep {};
+};
+
+
+// Trains mini-batch by mini-batch like ParallelTrainer's synchronous epochs,
+// zeroing the pruned weights after every update so they stay pruned.
+template <typename T>
+void fineTune(Network<T>& network, const PruningMask<T>& mask,
+			  util::nondeduced_t<util::span<const std::vector<T>>> inputs, util::span<const int> labels, int epochs,
+			  std::size_t threads = ThreadPool::global().concurrency());
+// The same for the samples of a view, normalized chunk by chunk in the
+// background by a BatchPipeline.
+template <typename T>
+void fineTune(Network<T>& network, const PruningMask<T>& mask, const DatasetView& samples, int epochs,
+			  std::size_t threads = ThreadPool::global().concurrency());
+
+extern template class PruningMask<float>;
+extern template class PruningMask<double>;
+extern template void fineTune<float>(Network<float>&, const PruningMask<float>&, util::span<const std::vector<float>>, util::span<const int>, int, std::size_t);
+extern template void fineTune<double>(Network<double>&, const PruningMask<double>&, util::span<const std::vector<double>>, util::span<const int>, int, std::size_t);
+extern template void fineTune<float>(Network<float>&, const PruningMask<float>&, const DatasetView&, int, std::size_t);
+extern template void fineTune<double>(Network<double>&, const PruningMask<double>&, const DatasetView&, int, std::size_t);
@@ -0,0 +1,188 @@
+#include "quantized_model.h"
+
+#include "activation.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+	// gemvU8S8 needs inputs within [0, 127]
+	const long MaxInput = 127;
+	const long MaxWeight = 127;
+
+	struct Range
+	{
+		float low {};
+		float high {};
+	};
+
+	// round(input / scale) + zeroPoint, clamped first so rounding is a truncation
+	// of a positive number and the loop vectorizes
+	template <typename T>
+	void quantizeInputs(std::size_t n, const T* input, float scale, std::int32_t zeroPoint, std::uint8_t* quantized)
+	{
+		const float inverse = 1.f / scale;
+		const float offset = float(zeroPoint) + 0.5f;
+		for (std::size_t i {}; i < n; i++)
+		{
+			const float value = std::min(std::max(float(input[i]) * inverse + offset, 0.f), MaxInput + 0.5f);
+			quantized[i] = static_cast<std::uint8_t>(value);
+		}
+	}
+}
+
+
+template <typename T>
+QuantizedModel::QuantizedModel(const Model<T>& model, util::nondeduced_t<util::span<const std::vector<T>>> calibration)
+	: activationType(model.activation())
+{
+	if (activationType == Activation::Custom)
+	{
+		throw std::runtime_error("Custom activations can't be quantized");
+	}
+
+	const auto& layers = model.layers();
+
+	// the ranges start at 0, so zero inputs stay exact
+	std::vector<Range> ranges(layers.size());
+	std::vector<T> current(model.maxLayerSize());
+	std::vector<T> next(model.maxLayerSize());
+	for (const auto& sample : calibration)
+	{
+		std::copy(sample.begin(), sample.end(), current.begin());
+		for (std::size_t layer = 1; layer < layers.size(); layer++)
+		{
+			const auto& parameters = layers[layer];
+			const auto bounds = std::minmax_element(current.begin(), current.begin() + parameters.previousSize);
+			ranges[layer].low = std::min(ranges[layer].low, float(*bounds.first));
+			ranges[layer].high = std::max(ranges[layer].high, float(*bounds.second));
+
+			std::copy(parameters.biases.begin(), parameters.biases.end(), next.begin());
+			kernels::gemv(parameters.size, parameters.previousSize, parameters.weights.data(), parameters.previousSize, current.data(), next.data());
+			activation::forward(activationType, parameters.size, next.data(), next.data());
+			std::swap(current, next);
+		}
+	}
+
+	for (std::size_t layer {}; layer < layers.size(); layer++)
+	{
+		const auto& source = layers[layer];
+		LayerParameters target;
+		target.size = source.size;
+		target.previousSize = source.previousSize;
+		target.stride = util::padded<std::int8_t>(source.previousSize);
+		target.weights.resize(target.size * target.stride);
+		target.scales.resize(target.size);
+		target.rowSums.resize(target.size);
+		target.biases.assign(source.biases.begin(), source.biases.end());
+
+		for (std::size_t n {}; n < target.size; n++)
+		{
+			const T* row = source.weights.data() + n * source.previousSize;
+			T largest {};
+			for (std::size_t c {}; c < source.previousSize; c++)
+			{
+				largest = std::max(largest, std::abs(row[c]));
+			}
+			const float scale = largest > 0 ? float(largest) / MaxWeight : 1.f;
+
+			std::int32_t sum {};
+			for (std::size_t c {}; c < source.previousSize; c++)
+			{
+				const long weight = std::clamp(std::lround(float(row[c]) / scale), -MaxWeight, MaxWeight);
+				target.weights[n * target.stride + c] = static_cast<std::int8_t>(weight);
+				sum += std::int32_t(weight);
+			}
+			target.scales[n] = scale;
+			target.rowSums[n] = sum;
+		}
+
+		const Range range = ranges[layer];
+		target.inputScale = range.high > range.low ? (range.high - range.low) / MaxInput : 1.f;
+		target.inputZeroPoint = std::int32_t(std::clamp(std::lround(-range.low / target.inputScale), 0L, MaxInput));
+
+		maxSize = std::max(maxSize, target.size);
+		layerParameters.push_back(std::move(target));
+	}
+}
+
+Architecture QuantizedModel::architecture() const
+{
+	Architecture result;
+	for (const auto& layer : layerParameters)
+	{
+		result.push_back(layer.size);
+	}
+	return result;
+}
+
+std::size_t QuantizedModel::weightBytes() const
+{
+	std::size_t result {};
+	for (const auto& layer : layerParameters)
+	{
+		result += layer.weights.size() * sizeof(std::int8_t) + layer.scales.size() * sizeof(float);
+	}
+	return result;
+}
+
+template <typename T>
+util::span<const float> QuantizedModel::predict(util::span<const T> input, QuantizedContext& context) const
+{
+	context.reserve(maxSize);
+	float* activations = context.activations.data();
+	std::uint8_t* quantized = context.quantized.data();
+	std::int32_t* sums = context.sums.data();
+
+	for (std::size_t layer = 1; layer < layerParameters.size(); layer++)
+	{
+		const auto& current_layer = layerParameters[layer];
+		if (layer == 1)
+		{
+			quantizeInputs(current_layer.previousSize, input.data(), current_layer.inputScale, current_layer.inputZeroPoint, quantized);
+		}
+		else
+		{
+			quantizeInputs(current_layer.previousSize, activations, current_layer.inputScale, current_layer.inputZeroPoint, quantized);
+		}
+
+		std::fill(sums, sums + current_layer.size, 0);
+		kernels::gemvU8S8(current_layer.size, current_layer.previousSize, current_layer.weights.data(), current_layer.stride, quantized, sums);
+
+		for (std::size_t n {}; n < current_layer.size; n++)
+		{
+			const std::int32_t dot = sums[n] - current_layer.inputZeroPoint * current_layer.rowSums[n];
+			activations[n] = current_layer.biases[n] + current_layer.scales[n] * current_layer.inputScale * float(dot);
+		}
+		activation::forward(activationType, current_layer.size, activations, activations);
+	}
+
+	return { activations, outputSize() };
+}
+
+template <typename T>
+int QuantizedModel::classify(util::span<const T> input, QuantizedContext& context) const
+{
+	return util::argmax(predict(input, context));
+}
+
+
+void QuantizedContext::reserve(std::size_t size)
+{
+	if (activations.size() < size)
+	{
+		quantized.resize(size);
+		sums.resize(size);
+		activations.resize(size);
+	}
+}
+
+template QuantizedModel::QuantizedModel(const Model<float>&, util::span<const std::vector<float>>);
+template QuantizedModel::QuantizedModel(const Model<double>&, util::span<const std::vector<double>>);
+template util::span<const float> QuantizedModel::predict<float>(util::span<const float>, QuantizedContext&) const;
+template util::span<const float> QuantizedModel::predict<double>(util::span<const double>, QuantizedContext&) const;
+template int QuantizedModel::classify<float>(util::span<const float>, QuantizedContext&) const;
+template int QuantizedModel::classify<double>(util::span<const double>, QuantizedContext&) const;
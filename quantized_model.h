@@ -0,0 +1,79 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <vector>
+
+class QuantizedContext;
+
+
+// int8 snapshot of a Model for inference. The weights of every neuron are
+// scaled to [-127, 127] by their largest magnitude; the inputs of every layer
+// are mapped affinely to [0, 127] over the range seen on calibration data.
+// The dot products run on kernels::gemvU8S8, biases, scales and activations
+// stay in float. Like Model it is const and shareable between threads.
+class QuantizedModel
+{
+public:
+
+	struct LayerParameters {
+		std::size_t size {};
+		std::size_t previousSize {};
+		// rows padded to whole cache lines
+		std::size_t stride {};
+		util::AlignedVector<std::int8_t> weights {};
+		// weight = scales[n] * quantized weight
+		std::vector<float> scales {};
+		// sum of the quantized weights of each row, to take out the input zero point
+		std::vector<std::int32_t> rowSums {};
+		std::vector<float> biases {};
+		// quantized input = round(input / inputScale) + inputZeroPoint
+		float inputScale {};
+		std::int32_t inputZeroPoint {};
+	};
+
+	// The calibration samples are run through the model to find the range of
+	// every layer's inputs. Throws for custom activations.
+	template <typename T>
+	QuantizedModel(const Model<T>& model, util::nondeduced_t<util::span<const std::vector<T>>> calibration);
+
+	Architecture architecture() const;
+	Activation activation() const { return activationType; }
+	std::size_t inputSize() const { return layerParameters.front().size; }
+	std::size_t outputSize() const { return layerParameters.back().size; }
+	const std::vector<LayerParameters>& layers() const { return layerParameters; }
+	// Bytes taken by the quantized weights and their scales.
+	std::size_t weightBytes() const;
+
+	// The result points into the context and stays valid until its next use.
+	template <typename T>
+	util::span<const float> predict(util::span<const T> input, QuantizedContext& context) const;
+	template <typename T>
+	int classify(util::span<const T> input, QuantizedContext& context) const;
+
+private:
+
+	std::vector<LayerParameters> layerParameters {};
+	std::size_t maxSize {};
+	Activation activationType {};
+};
+
+
+// Per-thread scratch space of QuantizedModel::predict.
+class QuantizedContext
+{
+public:
+
+	QuantizedContext() = default;
+
+private:
+
+	friend class QuantizedModel;
+
+	void reserve(std::size_t size);
+
+	util::AlignedVector<std::uint8_t> quantized {};
+	util::AlignedVector<std::int32_t> sums {};
+	util::AlignedVector<float> activations {};
+};
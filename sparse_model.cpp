@@ -0,0 +1,132 @@
+#include "sparse_model.h"
+
+#include "activation.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+template <typename T>
+SparseModel<T>::SparseModel(const Model<T>& model, Format format)
+	: storageFormat(format)
+	, activationType(model.activation())
+{
+	if (activationType == Activation::Custom)
+	{
+		throw std::runtime_error("Custom activations can't be used by a sparse model");
+	}
+
+	const std::size_t block = format == Format::Blocked ? kernels::SparseBlock<T> : 1;
+	for (const auto& source : model.layers())
+	{
+		LayerParameters target;
+		target.size = source.size;
+		target.previousSize = source.previousSize;
+		target.biases.assign(source.biases.begin(), source.biases.end());
+		target.offsets.push_back(0);
+
+		for (std::size_t n {}; n < source.size && source.previousSize > 0; n++)
+		{
+			const T* row = source.weights.data() + n * source.previousSize;
+			for (std::size_t c {}; c < source.previousSize; c += block)
+			{
+				const std::size_t end = std::min(c + block, source.previousSize);
+				if (std::all_of(row + c, row + end, [](T weight) { return weight == T{}; }))
+				{
+					continue;
+				}
+				target.columns.push_back(std::uint32_t(c));
+				target.values.insert(target.values.end(), row + c, row + end);
+				// the last block of a row is padded with zeros
+				target.values.resize(target.columns.size() * block);
+			}
+			target.offsets.push_back(std::uint32_t(target.columns.size()));
+		}
+
+		maxSize = std::max(maxSize, target.size);
+		layerParameters.push_back(std::move(target));
+	}
+}
+
+template <typename T>
+Architecture SparseModel<T>::architecture() const
+{
+	Architecture result;
+	for (const auto& layer : layerParameters)
+	{
+		result.push_back(layer.size);
+	}
+	return result;
+}
+
+template <typename T>
+std::size_t SparseModel<T>::storedWeights() const
+{
+	std::size_t result {};
+	for (const auto& layer : layerParameters)
+	{
+		result += layer.values.size();
+	}
+	return result;
+}
+
+template <typename T>
+std::size_t SparseModel<T>::weightBytes() const
+{
+	std::size_t result {};
+	for (const auto& layer : layerParameters)
+	{
+		result += layer.values.size() * sizeof(T) + (layer.columns.size() + layer.offsets.size()) * sizeof(std::uint32_t);
+	}
+	return result;
+}
+
+template <typename T>
+util::span<const T> SparseModel<T>::predict(util::span<const T> input, InferenceContext<T>& context) const
+{
+	// blocks read up to the end of the cache line holding the last input
+	context.reserve(util::padded<T>(maxSize));
+
+	const T* previous_activations = input.data();
+	if (storageFormat == Format::Blocked)
+	{
+		T* padded = context.buffers[0].data();
+		std::copy(input.begin(), input.end(), padded);
+		std::fill(padded + input.size(), padded + util::padded<T>(input.size()), T{});
+		previous_activations = padded;
+	}
+
+	for (std::size_t layer = 1; layer < layerParameters.size(); layer++)
+	{
+		const auto& current_layer = layerParameters[layer];
+		T* activations = context.buffers[layer % 2].data();
+
+		std::copy(current_layer.biases.begin(), current_layer.biases.end(), activations);
+		if (storageFormat == Format::Blocked)
+		{
+			kernels::blockedGemv(current_layer.size, current_layer.offsets.data(), current_layer.columns.data(),
+								 current_layer.values.data(), previous_activations, activations);
+		}
+		else
+		{
+			kernels::csrGemv(current_layer.size, current_layer.offsets.data(), current_layer.columns.data(),
+							 current_layer.values.data(), previous_activations, activations);
+		}
+
+		activation::forward(activationType, current_layer.size, activations, activations);
+		std::fill(activations + current_layer.size, activations + util::padded<T>(current_layer.size), T{});
+		previous_activations = activations;
+	}
+
+	return { previous_activations, outputSize() };
+}
+
+template <typename T>
+int SparseModel<T>::classify(util::span<const T> input, InferenceContext<T>& context) const
+{
+	return util::argmax(predict(input, context));
+}
+
+template class SparseModel<float>;
+template class SparseModel<double>;
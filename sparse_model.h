@@ -0,0 +1,62 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// Model with only the nonzero weights stored, for networks thinned by
+// PruningMask. Csr keeps single weights and gathers their inputs; Blocked
+// keeps every cache line of a row (kernels::SparseBlock<T> weights) with a
+// nonzero in it and reads the inputs contiguously, which pays off when the
+// weights were pruned in whole blocks. Like Model it is const and shareable
+// between threads.
+template <typename T = double>
+class SparseModel
+{
+public:
+
+	using value_type = T;
+
+	enum class Format { Csr, Blocked };
+
+	// Row n holds the entries offsets[n] to offsets[n + 1] - 1, each a single
+	// weight (Csr) or a block of weights (Blocked) starting at its column.
+	struct LayerParameters {
+		std::size_t size {};
+		std::size_t previousSize {};
+		std::vector<std::uint32_t> offsets {};
+		std::vector<std::uint32_t> columns {};
+		util::AlignedVector<T> values {};
+		std::vector<T> biases {};
+	};
+
+	// Throws for custom activations.
+	SparseModel(const Model<T>& model, Format format);
+
+	Architecture architecture() const;
+	Activation activation() const { return activationType; }
+	Format format() const { return storageFormat; }
+	std::size_t inputSize() const { return layerParameters.front().size; }
+	std::size_t outputSize() const { return layerParameters.back().size; }
+	const std::vector<LayerParameters>& layers() const { return layerParameters; }
+	// Weights stored, the zeros inside blocks included.
+	std::size_t storedWeights() const;
+	// Bytes taken by the weights and their indices.
+	std::size_t weightBytes() const;
+
+	// The result points into the context and stays valid until its next use.
+	util::span<const T> predict(util::span<const T> input, InferenceContext<T>& context) const;
+	int classify(util::span<const T> input, InferenceContext<T>& context) const;
+
+private:
+
+	std::vector<LayerParameters> layerParameters {};
+	std::size_t maxSize {};
+	Format storageFormat {};
+	Activation activationType {};
+};
+
+extern template class SparseModel<float>;
+extern template class SparseModel<double>;
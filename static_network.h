@@ -1,188 +1,309 @@
 #pragma once
 
+#include "arena.h"
+#include "kernels.h"
 #include "util.h"
 
+#include <algorithm>
 #include <array>
-
-
-template <std::size_t Inputs>
-struct StaticNeuron
-{
-	static constexpr std::size_t Inputs = Inputs;
-
-	double activation {};
-	double z {};
-
-	std::array<double, Inputs> weights {};
-	double bias {};
-};
-
-template <std::size_t Size, std::size_t PreviousSize>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+// A layer whose sizes are known at compile time, stored like Layer as a
+// row-major weight matrix next to per-neuron arrays. Rows and arrays are padded
+// to whole cache lines, which hold a whole number of SIMD registers of any
+// width, and the padding stays zero: the kernels run over the padded sizes and
+// never take their remainder paths.
+template <typename T, std::size_t LayerSize, std::size_t PreviousLayerSize>
 struct StaticLayer
 {
-	static const std::size_t Size = Size;
-	static const std::size_t PreviousSize = PreviousSize;
+	static constexpr std::size_t Size = LayerSize;
+	static constexpr std::size_t PreviousSize = PreviousLayerSize;
+	static constexpr std::size_t PaddedSize = util::padded<T>(Size);
+	// distance between the rows of weights
+	static constexpr std::size_t Stride = util::padded<T>(PreviousSize);
 
-	std::array<StaticNeuron<PreviousSize>, Size> neurons;
-	std::array<double, Size> errors;
+	T& weight(std::size_t n, std::size_t pn) { return weights[n * Stride + pn]; }
+	const T& weight(std::size_t n, std::size_t pn) const { return weights[n * Stride + pn]; }
 
-	template <typename ActivationsType>
-	void applyActivations(const ActivationsType& activations)
-	{
-		for (size_t i{}; i < activations.size(); ++i)
-		{
-			neurons[i].activation = activations[i];
-		}
-	}
-	std::array<double, Size> activations()
+	void applyActivations(util::span<const T> input)
 	{
-		std::array<double, Size> activations;
-		for (size_t i{}; i < activations.size(); ++i)
-		{
-			activations[i] = neurons[i].activation;
-		}
-		return activations;
+		std::copy(input.begin(), input.begin() + Size, activations.begin());
 	}
+
+	alignas(util::CacheLineSize) std::array<T, Size * Stride> weights {};
+	alignas(util::CacheLineSize) std::array<T, PaddedSize> biases {};
+
+	alignas(util::CacheLineSize) std::array<T, PaddedSize> activations {};
+	alignas(util::CacheLineSize) std::array<T, PaddedSize> z {};
+	alignas(util::CacheLineSize) std::array<T, PaddedSize> errors {};
+
+	// summed over the samples of a mini-batch until they are applied
+	alignas(util::CacheLineSize) std::array<T, Size * Stride> weightGradients {};
+	alignas(util::CacheLineSize) std::array<T, PaddedSize> biasGradients {};
 };
 
 using ActivationFunctionType = double (*)(double);
-template <std::size_t Inputs, std::size_t Hidden, std::size_t Outputs, ActivationFunctionType ActivationFunc, ActivationFunctionType ActivationFuncDerivative, int LearningRate>
+
+// A network of any depth whose layer sizes (input first) are template
+// arguments: StaticNetwork<float, &util::leakyRelu, &util::leakyReluPrime, 784, 256, 128, 10>.
+// The layers are a tuple of StaticLayer folded over pairwise, so every size is
+// a constant; the products run on the dispatched kernels like Network's.
+// The layers live on the heap, so large networks can still be local variables.
+//
+// Training follows Network: learnOnce sums the gradients of batchSize samples
+// before applying their average, learnBatch applies it after the given
+// samples. With a batch size of 1 learnOnce updates the weights in place.
+// Inputs are any contiguous containers of T, targets are containers of
+// Outputs values or class indices.
+template <typename T, ActivationFunctionType ActivationFunc, ActivationFunctionType ActivationFuncDerivative, std::size_t... Sizes>
 class StaticNetwork
 {
+	static_assert(sizeof...(Sizes) >= 2, "a network needs at least an input and an output layer");
+
+	static constexpr std::array<std::size_t, sizeof...(Sizes)> LayerSizes { Sizes... };
+
+	template <std::size_t... I>
+	static auto makeLayers(std::index_sequence<I...>) -> std::tuple<StaticLayer<T, LayerSizes[I], (I > 0 ? LayerSizes[I - 1] : 0)>...>;
+
 public:
-	enum LayerIds { INPUT_LAYER = 0, HIDDEN_LAYER = 1, OUTPUT_LAYER = 2 };
+	using value_type = T;
+	using Layers = decltype(makeLayers(std::make_index_sequence<sizeof...(Sizes)>{}));
 
+	static constexpr std::size_t LayerCount = sizeof...(Sizes);
+	static constexpr std::size_t Inputs = LayerSizes.front();
+	static constexpr std::size_t Outputs = LayerSizes.back();
 
-	StaticNetwork()
-	{
 
-		const auto randomize = [](auto& layer)
+	explicit StaticNetwork(T learningRate = T(0.3), std::size_t batchSize = 1)
+		: layers(std::make_unique<Layers>())
+		, learningRate(learningRate)
+		, batchSize(std::max<std::size_t>(batchSize, 1))
+	{
+		forEachLayer([](auto& layer)
 		{
-			for (std::size_t i {}; i < layer.neurons.size(); i++)
+			for (std::size_t n {}; n < layer.Size; n++)
 			{
-				auto& neuron = layer.neurons[i];
-				for (std::size_t j {}; j < neuron.weights.size(); j++)
+				for (std::size_t pn {}; pn < layer.PreviousSize; pn++)
 				{
-					neuron.weights[j] = util::randomNormal();
+					layer.weight(n, pn) = static_cast<T>(util::randomNormal());
 				}
-				neuron.bias = util::randomNormal();
+				layer.biases[n] = static_cast<T>(util::randomNormal());
 			}
-		};
-		apply_on_layer<INPUT_LAYER>(randomize);
-		apply_on_layer<HIDDEN_LAYER>(randomize);
-		apply_on_layer<OUTPUT_LAYER>(randomize);
+		});
+	}
+
+	StaticNetwork(const StaticNetwork& other)
+		: layers(std::make_unique<Layers>(*other.layers))
+		, learningRate(other.learningRate)
+		, batchSize(other.batchSize)
+		, batchCounter(other.batchCounter)
+	{
+	}
+	StaticNetwork(StaticNetwork&&) = default;
+	StaticNetwork& operator=(const StaticNetwork& other)
+	{
+		*layers = *other.layers;
+		learningRate = other.learningRate;
+		batchSize = other.batchSize;
+		batchCounter = other.batchCounter;
+		return *this;
 	}
+	StaticNetwork& operator=(StaticNetwork&&) = default;
 
+	template <std::size_t I>
+	auto& layer() { return std::get<I>(*layers); }
+	template <std::size_t I>
+	const auto& layer() const { return std::get<I>(*layers); }
 
-	std::array<double, Outputs> feedForward(const std::vector<double>& input)
+	std::size_t miniBatchSize() const { return batchSize; }
+
+
+	std::array<T, Outputs> feedForward(util::span<const T> input)
 	{
-		std::get<0>(layers).applyActivations(input);
+		propagate(input);
 
-		const auto feedForwardLayer = [](auto& layer, auto& next_layer)
-		{
-			auto& current_layer_neurons = next_layer.neurons;
-			auto& previous_layer_neurons = layer.neurons;
-			for (std::size_t n {}; n < current_layer_neurons.size(); n++)
-			{
-				current_layer_neurons[n].z = {};
-				for (std::size_t pn {}; pn < previous_layer_neurons.size(); pn++)
-				{
-					current_layer_neurons[n].z += current_layer_neurons[n].weights[pn] * previous_layer_neurons[pn].activation;
-				}
-				current_layer_neurons[n].z += current_layer_neurons[n].bias;
-				auto z = current_layer_neurons[n].z;
-				current_layer_neurons[n].activation = ActivationFunc(current_layer_neurons[n].z);
-			}
-		};
+		const auto& activations = outputLayer().activations;
+		std::array<T, Outputs> output;
+		std::copy(activations.begin(), activations.begin() + Outputs, output.begin());
+		return output;
+	}
 
-		apply_on_layer_and_next<0>(feedForwardLayer);
-		apply_on_layer_and_next<1>(feedForwardLayer);
+	// Allocation free: output must hold Outputs elements.
+	void feedForward(util::span<const T> input, util::span<T> output)
+	{
+		propagate(input);
 
-		return std::get<OUTPUT_LAYER>(layers).activations();
+		const auto& activations = outputLayer().activations;
+		std::copy(activations.begin(), activations.begin() + Outputs, output.begin());
+	}
 
+	int classify(util::span<const T> input)
+	{
+		propagate(input);
+
+		const auto& activations = outputLayer().activations;
+		return std::distance(activations.begin(), std::max_element(activations.begin(), activations.begin() + Outputs));
 	}
 
-	template <typename InputContainer, typename ExpectedContainer>
-	void learnOnce(const InputContainer& input, const ExpectedContainer& expected)
+	void propagate(util::span<const T> input)
 	{
-		feedForward(input);
+		layer<0>().applyActivations(input);
 
-		apply_on_layer<OUTPUT_LAYER>([&expected](auto& layer)
+		forEachLayerPair([](const auto& previous_layer, auto& current_layer)
 		{
-			const auto& last_layer_neurons = layer.neurons;
-			auto& last_layer_errors = layer.errors;
-
-			for (std::size_t n {}; n < last_layer_neurons.size(); n++)
+			using Layer = std::decay_t<decltype(current_layer)>;
+			std::copy(current_layer.biases.begin(), current_layer.biases.end(), current_layer.z.begin());
+			kernels::gemv(Layer::Size, Layer::Stride, current_layer.weights.data(), Layer::Stride, previous_layer.activations.data(), current_layer.z.data());
+			for (std::size_t n {}; n < Layer::Size; n++)
 			{
-				last_layer_errors[n] = (last_layer_neurons[n].activation - expected[n]) * ActivationFuncDerivative(last_layer_neurons[n].z);
+				current_layer.activations[n] = static_cast<T>(ActivationFunc(current_layer.z[n]));
 			}
 		});
+	}
+
+	template <typename Expected>
+	void learnOnce(util::span<const T> input, const Expected& expected)
+	{
+		backpropagate(input, expected);
 
-		const auto calculateInnerError = [](auto& layer, auto& next_layer)
+		if (batchSize == 1)
 		{
-			const auto& current_layer_neurons = layer.neurons;
-			auto& current_layer_errors = layer.errors;
+			forEachLayerPair([rate = learningRate](const auto& previous_layer, auto& current_layer)
+			{
+				using Layer = std::decay_t<decltype(current_layer)>;
+				kernels::ger(Layer::Size, Layer::Stride, -rate, current_layer.errors.data(), previous_layer.activations.data(), current_layer.weights.data(), Layer::Stride);
+				kernels::axpy(Layer::Size, -rate, current_layer.errors.data(), current_layer.biases.data());
+			});
+			return;
+		}
 
-			const auto& next_layer_neurons = next_layer.neurons;
-			const auto& next_layer_errors = next_layer.errors;
+		accumulateGradients();
+		if (++batchCounter == batchSize)
+		{
+			applyGradients(batchSize);
+			batchCounter = 0;
+		}
+	}
 
-			for (std::size_t n {}; n < current_layer_neurons.size(); n++)
-			{
-				current_layer_errors[n] = {};
-				for (std::size_t nn {}; nn < next_layer_neurons.size(); nn++)
-				{
-					current_layer_errors[n] += next_layer_neurons[nn].weights[n] * next_layer_errors[nn];
-				}
-				current_layer_errors[n] *= ActivationFuncDerivative(current_layer_neurons[n].z);
-			}
-		};
+	// inputs[i] is a contiguous container of T, expected[i] a container of
+	// Outputs values or a class index.
+	template <typename InputRange, typename ExpectedRange>
+	void learnBatch(const InputRange& inputs, const ExpectedRange& expected)
+	{
+		const std::size_t samples = std::size(inputs);
+		if (samples == 0)
+		{
+			return;
+		}
+
+		for (std::size_t s {}; s < samples; s++)
+		{
+			backpropagate(inputs[s], expected[s]);
+			accumulateGradients();
+		}
+
+		applyGradients(samples + batchCounter);
+		batchCounter = 0;
+	}
 
-		apply_on_layer_and_next<HIDDEN_LAYER>(calculateInnerError);
-		apply_on_layer_and_next<INPUT_LAYER>(calculateInnerError);
+private:
 
-		const auto correctWeights = [](auto& layer, auto& next_layer)
+	auto& outputLayer() { return layer<LayerCount - 1>(); }
+
+	template <typename Container>
+	static T target(const Container& expected, std::size_t n) { return static_cast<T>(expected[n]); }
+	static T target(int label, std::size_t n) { return T(label == int(n)); }
+
+	// propagates and leaves the error of every layer
+	template <typename Expected>
+	void backpropagate(util::span<const T> input, const Expected& expected)
+	{
+		propagate(input);
+
+		auto& last_layer = outputLayer();
+		for (std::size_t n {}; n < Outputs; n++)
 		{
-			auto& current_layer_neurons = next_layer.neurons;
-			const auto& current_layer_errors = next_layer.errors;
-			const auto& previous_layer_neurons = layer.neurons;
+			last_layer.errors[n] = (last_layer.activations[n] - target(expected, n)) * static_cast<T>(ActivationFuncDerivative(last_layer.z[n]));
+		}
 
-			for (std::size_t n {}; n < current_layer_neurons.size(); n++)
+		// errors = (W_next^T * errors_next) .* f'(z), from the back; the input layer needs none
+		forEachLayerPairReversed([](auto& current_layer, const auto& next_layer)
+		{
+			using Layer = std::decay_t<decltype(current_layer)>;
+			using Next = std::decay_t<decltype(next_layer)>;
+			if constexpr (Layer::PreviousSize > 0)
 			{
-				auto& current_neuron = current_layer_neurons[n];
-
-				for (std::size_t pn {}; pn < current_neuron.weights.size(); pn++)
+				std::fill(current_layer.errors.begin(), current_layer.errors.end(), T{});
+				kernels::gemvT(Next::Size, Next::Stride, next_layer.weights.data(), Next::Stride, next_layer.errors.data(), current_layer.errors.data());
+				for (std::size_t n {}; n < Layer::Size; n++)
 				{
-					const auto weight_correction = current_layer_errors[n] * previous_layer_neurons[pn].activation * LearningRate / 1000.;
-					current_neuron.weights[pn] -= weight_correction;
+					current_layer.errors[n] *= static_cast<T>(ActivationFuncDerivative(current_layer.z[n]));
 				}
-
-				const auto bias_correction = current_layer_errors[n] * LearningRate / 1000.;
-				current_neuron.bias -= bias_correction;
 			}
-		};
-
-		apply_on_layer_and_next<HIDDEN_LAYER>(correctWeights);
-		apply_on_layer_and_next<INPUT_LAYER>(correctWeights);
+		});
+	}
 
+	void accumulateGradients()
+	{
+		forEachLayerPair([](const auto& previous_layer, auto& current_layer)
+		{
+			using Layer = std::decay_t<decltype(current_layer)>;
+			kernels::ger(Layer::Size, Layer::Stride, T{1}, current_layer.errors.data(), previous_layer.activations.data(), current_layer.weightGradients.data(), Layer::Stride);
+			kernels::axpy(Layer::Size, T{1}, current_layer.errors.data(), current_layer.biasGradients.data());
+		});
+	}
 
+	// the average gradient over the samples, then clears them
+	void applyGradients(std::size_t samples)
+	{
+		const T rate = learningRate / T(samples);
+		forEachLayerPair([rate](const auto&, auto& current_layer)
+		{
+			kernels::axpy(current_layer.weights.size(), -rate, current_layer.weightGradients.data(), current_layer.weights.data());
+			kernels::axpy(current_layer.biases.size(), -rate, current_layer.biasGradients.data(), current_layer.biases.data());
+			std::fill(current_layer.weightGradients.begin(), current_layer.weightGradients.end(), T{});
+			std::fill(current_layer.biasGradients.begin(), current_layer.biasGradients.end(), T{});
+		});
 	}
 
-	std::tuple<
-		StaticLayer<Inputs, 0>,
-		StaticLayer<Hidden, Inputs>,
-		StaticLayer<Outputs, Hidden>> layers;
+	template <typename Function>
+	void forEachLayer(Function function)
+	{
+		std::apply([&](auto&... layer) { (function(layer), ...); }, *layers);
+	}
 
-	template <std::size_t I, typename Function>
-	void apply_on_layer(Function func)
+	// function(layer I, layer I + 1) for every I, first to last
+	template <typename Function>
+	void forEachLayerPair(Function function)
 	{
-		func(std::get<I>(layers));
+		forEachLayerPair(function, std::make_index_sequence<LayerCount - 1>{});
 	}
-	template <std::size_t I, typename Function>
-	void apply_on_layer_and_next(Function func)
+	template <typename Function, std::size_t... I>
+	void forEachLayerPair(Function function, std::index_sequence<I...>)
 	{
-		func(std::get<I>(layers), std::get<I + 1>(layers));
+		(function(layer<I>(), layer<I + 1>()), ...);
 	}
 
-};
+	// the same, last to first
+	template <typename Function>
+	void forEachLayerPairReversed(Function function)
+	{
+		forEachLayerPairReversed(function, std::make_index_sequence<LayerCount - 1>{});
+	}
+	template <typename Function, std::size_t... I>
+	void forEachLayerPairReversed(Function function, std::index_sequence<I...>)
+	{
+		(function(layer<LayerCount - 2 - I>(), layer<LayerCount - 1 - I>()), ...);
+	}
 
+	std::unique_ptr<Layers> layers;
 
+	T learningRate {};
+	std::size_t batchSize {};
+	std::size_t batchCounter {};
+};
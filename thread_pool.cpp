@@ -0,0 +1,231 @@
+#include "thread_pool.h"
+
+#include <cstdlib>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace
+{
+	thread_local const ThreadPool* current_pool {};
+	thread_local std::size_t current_index {};
+
+	void pinToCore(std::thread& thread, std::size_t core)
+	{
+#if defined(__linux__)
+		cpu_set_t cores;
+		CPU_ZERO(&cores);
+		CPU_SET(core, &cores);
+		pthread_setaffinity_np(thread.native_handle(), sizeof(cores), &cores);
+#elif defined(_WIN32)
+		SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << core);
+#else
+		(void)thread;
+		(void)core;
+#endif
+	}
+}
+
+
+ThreadPool::ThreadPool(std::size_t threads, bool pinThreads)
+	: queueCount(std::max<std::size_t>(threads, 1))
+	, queues(new Queue[queueCount])
+{
+	const std::size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+	workers.reserve(queueCount - 1);
+	for (std::size_t i = 0; i + 1 < queueCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::work, this, i);
+		if (pinThreads)
+		{
+			// core 0 is left to the thread that submits the work
+			pinToCore(workers.back(), (i + 1) % cores);
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopping = true;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wakeUp.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::global()
+{
+	static ThreadPool pool(defaultConcurrency(), std::getenv("NEURAL_PIN_THREADS") && std::string(std::getenv("NEURAL_PIN_THREADS")) == "1");
+	return pool;
+}
+
+std::size_t ThreadPool::defaultConcurrency()
+{
+	if (const char* threads = std::getenv("NEURAL_THREADS"))
+	{
+		return std::max(std::atoi(threads), 1);
+	}
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void ThreadPool::submit(Task task)
+{
+	const std::size_t index = current_pool == this ? current_index : queueCount - 1;
+
+	// counted before it is visible, so a thief never takes it below zero
+	queued.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(queues[index].mutex);
+		queues[index].tasks.push_back(std::move(task));
+	}
+
+	if (sleeping.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wakeUp.notify_one();
+	}
+}
+
+bool ThreadPool::runPendingTask()
+{
+	const std::size_t index = current_pool == this ? current_index : queueCount - 1;
+
+	Task task;
+	if (!popOwn(index, task) && !steal(index, task))
+	{
+		return false;
+	}
+	queued.fetch_sub(1);
+
+	task();
+	return true;
+}
+
+bool ThreadPool::popOwn(std::size_t index, Task& task)
+{
+	auto& queue = queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	return true;
+}
+
+bool ThreadPool::steal(std::size_t thief, Task& task)
+{
+	for (std::size_t i = 1; i < queueCount; i++)
+	{
+		auto& queue = queues[(thief + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::work(std::size_t index)
+{
+	static const int SpinCount = 64;
+
+	current_pool = this;
+	current_index = index;
+
+	for (;;)
+	{
+		if (runPendingTask())
+		{
+			continue;
+		}
+
+		bool found {};
+		for (int spin {}; spin < SpinCount && !found; spin++)
+		{
+			std::this_thread::yield();
+			found = queued.load() > 0;
+		}
+		if (found)
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping.fetch_add(1);
+		wakeUp.wait(lock, [&] { return stopping.load() || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		if (stopping.load() && queued.load() == 0)
+		{
+			return;
+		}
+	}
+}
+
+
+TaskGroup::~TaskGroup()
+{
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		if (!pool.runPendingTask())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TaskGroup::run(ThreadPool::Task task)
+{
+	pending.fetch_add(1, std::memory_order_relaxed);
+	pool.submit([this, task = std::move(task)]
+	{
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+		pending.fetch_sub(1, std::memory_order_release);
+	});
+}
+
+void TaskGroup::wait()
+{
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		if (!pool.runPendingTask())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(errorMutex);
+	if (error)
+	{
+		auto rethrown = error;
+		error = nullptr;
+		std::rethrow_exception(rethrown);
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing task scheduler. Every worker owns a deque: it pushes and pops
+// its own tasks at the back and steals from the front of the others' when it
+// runs dry, so large chunks split off early get stolen first. Threads outside
+// the pool submit through an extra injection queue and help running tasks
+// while they wait for them.
+class ThreadPool
+{
+public:
+
+	using Task = std::function<void()>;
+
+	// threads is the total parallelism including the thread that waits, so
+	// threads - 1 workers are started.
+	explicit ThreadPool(std::size_t threads = defaultConcurrency(), bool pinThreads = false);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// The pool shared by training, evaluation and data loading. Sized by
+	// NEURAL_THREADS (default: all cores), NEURAL_PIN_THREADS=1 pins workers.
+	static ThreadPool& global();
+	static std::size_t defaultConcurrency();
+
+	std::size_t concurrency() const { return queueCount; }
+
+	void submit(Task task);
+
+	// Runs one queued task if there is any; used by the waiting threads.
+	bool runPendingTask();
+
+private:
+
+	struct alignas(util::CacheLineSize) Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void work(std::size_t index);
+	bool popOwn(std::size_t index, Task& task);
+	bool steal(std::size_t thief, Task& task);
+
+	// one per worker, the last one for outside threads
+	const std::size_t queueCount;
+	std::unique_ptr<Queue[]> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<std::size_t> queued {};
+	std::atomic<std::size_t> sleeping {};
+	std::atomic<bool> stopping {};
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+};
+
+
+// Tasks that are waited for together. wait() runs pending tasks of the pool
+// instead of blocking and rethrows the first exception thrown by a task.
+class TaskGroup
+{
+public:
+
+	explicit TaskGroup(ThreadPool& pool = ThreadPool::global()) : pool(pool) { }
+	~TaskGroup();
+
+	void run(ThreadPool::Task task);
+	void wait();
+
+private:
+
+	ThreadPool& pool;
+	std::atomic<std::size_t> pending {};
+	std::mutex errorMutex;
+	std::exception_ptr error {};
+};
+
+
+namespace detail
+{
+	template <typename Body>
+	void splitRange(TaskGroup& group, std::size_t first, std::size_t last, std::size_t grain, const Body& body)
+	{
+		// halves are handed to the pool until a piece fits the grain
+		while (last - first > grain)
+		{
+			const std::size_t middle = first + (last - first) / 2;
+			group.run([&group, middle, last, grain, &body] { splitRange(group, middle, last, grain, body); });
+			last = middle;
+		}
+		body(first, last);
+	}
+}
+
+// Calls body(begin, end) on disjoint subranges of [first, last) that are at
+// most grain long and returns when all of them are done.
+template <typename Body>
+void parallel_for(std::size_t first, std::size_t last, std::size_t grain, const Body& body, ThreadPool& pool = ThreadPool::global())
+{
+	if (first >= last)
+	{
+		return;
+	}
+	grain = std::max<std::size_t>(grain, 1);
+	if (pool.concurrency() == 1)
+	{
+		for (std::size_t begin = first; begin < last; begin += grain)
+		{
+			body(begin, std::min(begin + grain, last));
+		}
+		return;
+	}
+
+	TaskGroup group(pool);
+	detail::splitRange(group, first, last, grain, body);
+	group.wait();
+}
+
+// parallel_for with a grain that gives every thread a few pieces to balance.
+template <typename Body>
+void parallel_for(std::size_t first, std::size_t last, const Body& body, ThreadPool& pool = ThreadPool::global())
+{
+	const std::size_t pieces = 4 * pool.concurrency();
+	parallel_for(first, last, (last - first + pieces - 1) / pieces, body, pool);
+}
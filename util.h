@@ -1,12 +1,81 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <new>
 #include <numeric>
 #include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace util
 {
 
+template <typename T>
+struct span
+{
+	span() = default;
+	span(T* data, std::size_t size) : ptr(data), count(size) { }
+
+	template <typename Container, typename = std::enable_if_t<std::is_convertible<decltype(std::declval<Container&>().data()), T*>::value>>
+	span(Container& container) : ptr(container.data()), count(container.size()) { }
+
+	T* data() const { return ptr; }
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T* begin() const { return ptr; }
+	T* end() const { return ptr + count; }
+
+	T& operator[](std::size_t i) const { return ptr[i]; }
+
+	span subspan(std::size_t offset, std::size_t size) const { return { ptr + offset, size }; }
+
+	T* ptr {};
+	std::size_t count {};
+};
+
+// Keeps a function parameter out of template argument deduction.
+template <typename T>
+struct nondeduced { using type = T; };
+template <typename T>
+using nondeduced_t = typename nondeduced<T>::type;
+
+constexpr std::size_t CacheLineSize = 64;
+
+template <typename T, std::size_t Alignment = CacheLineSize>
+struct AlignedAllocator
+{
+	using value_type = T;
+
+	template <typename U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) { }
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+	}
+	void deallocate(T* p, std::size_t)
+	{
+		::operator delete(p, std::align_val_t{Alignment});
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
 template <typename T1, typename T2>
 struct zip2_iterator
 {
@@ -147,7 +216,8 @@ inline double sigmoid(double input)
 }
 inline double sigmoidPrime(double input)
 {
-	return sigmoid(input) * (1 - sigmoid(input));
+	const double s = sigmoid(input);
+	return s * (1 - s);
 }
 
 inline double relu(double input)
@@ -159,13 +229,15 @@ inline double reluPrime(double input)
 	return input < 0 ? 0.0 : 1;
 }
 
+constexpr double LeakyReluSlope = 0.02;
+
 inline double leakyRelu(double input)
 {
-	return input < 0 ? 0.02*input : input;
+	return input < 0 ? LeakyReluSlope*input : input;
 }
 inline double leakyReluPrime(double input)
 {
-	return input < 0 ? 0.02 : 1;
+	return input < 0 ? LeakyReluSlope : 1;
 }
 
 inline double identity(double input)